@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <boost/shared_ptr.hpp>
+
+#include <opencv2/opencv.hpp>
+
+#include <ros/time.h>
+
+// 一帧同步后的彩色/深度数据, seq 从1开始单调递增
+struct CameraFrame
+{
+    uint64_t seq = 0;
+    ros::Time stamp;
+    cv::Mat color;
+    cv::Mat depth;
+    boost::shared_ptr<const void> holder; // 保持被引用的原始消息
+};
+
+// 帧缓冲策略
+enum class FramePolicy
+{
+    LatestOnly,  // 只保留最新一帧, 未转换的旧帧直接覆盖(计为丢帧)
+    BoundedQueue // 有界队列, 满时阻塞同步回调(反压), 超时后丢弃最旧帧
+};
+
+// 接收端帧统计, 计数器可在任意线程读取
+struct FrameStats
+{
+    std::atomic<uint64_t> received_color{0}; // 收到的彩色图像消息数
+    std::atomic<uint64_t> received_depth{0}; // 收到的深度图像消息数
+    std::atomic<uint64_t> synced{0};         // 同步成功的帧数
+    std::atomic<uint64_t> dropped{0};        // 未生成点云即被覆盖/丢弃的帧数
+    std::atomic<uint64_t> converted{0};      // 已生成点云的帧数
+    std::atomic<uint64_t> consumed{0};       // 被检测器使用的不同帧数
+    std::atomic<uint64_t> reprocessed{0};    // 检测器重复处理同一帧的次数
+    std::atomic<uint64_t> idle{0};           // 检测器等待新帧超时的次数, 即按序号驱动后省去的重复处理
+    std::atomic<double> receive_latency_ms{0}; // 图像时间戳到同步回调的平均延迟
+    std::atomic<double> convert_latency_ms{0}; // 图像时间戳到点云生成完成的平均延迟
+};
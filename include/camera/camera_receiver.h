@@ -10,9 +10,15 @@
 #include <string>
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <atomic>
 #include <mutex>
 #include <thread>
 #include <chrono>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <condition_variable>
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
@@ -23,8 +29,10 @@
 
 #include <ros/ros.h>
 #include <ros/spinner.h>
+#include <ros/callback_queue.h>
 #include <sensor_msgs/CameraInfo.h>
 #include <sensor_msgs/Image.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 
 #include <cv_bridge/cv_bridge.h>
 
@@ -36,12 +44,46 @@
 #include <message_filters/sync_policies/exact_time.h>
 #include <message_filters/sync_policies/approximate_time.h>
 
+#include "camera/camera_frame.h"
+
+// 降采样模式
+enum class PyramidMode
+{
+    Stride,    // 隔点采样
+    MinPool,   // 块内最小有效深度(保留前景边缘)
+    MedianPool // 块内有效深度中值(抑制噪声)
+};
+
+// 一层降采样数据, scale = 2^level, 与原始点云一样按行组织
+struct CloudLevel
+{
+    int scale = 1;
+    cv::Mat color, depth;
+    cv::Mat lookupX, lookupY; // 与该层像素对应的归一化射线表
+    cv::Mat cameraMatrix;     // 该层对应的内参
+    pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloud;
+};
+
+// 一帧转换完成后的只读数据(各层图像、射线表与点云), 由接收器从缓存池分配:
+// 持有期间接收器不会改写, 检测器直接借用而无需拷贝; 所有持有者释放后缓存回到池中复用
+struct CloudFrame
+{
+    uint64_t seq = 0;
+    ros::Time stamp;
+    std::vector<CloudLevel> levels; // levels[0] 为原始分辨率, 之后为已生成的降采样层
+    boost::shared_ptr<const void> holder; // 未在主机端配准时 levels[0].depth 直接引用原始消息, 由此保持其生命周期
+};
+typedef std::shared_ptr<const CloudFrame> CloudFramePtr;
+
 class CameraReceiver
 {
 public:
+    static const int kMaxPyramidLevel = 2; // 最多降采样到 1/4
     CameraReceiver(const ros::NodeHandle &node, std::string topicColor, std::string topicDepth, const bool useExact, const bool useCompressed, int rate)
         : topicColor(std::move(topicColor)), topicDepth(std::move(topicDepth)), useExact(useExact), useCompressed(useCompressed),
-          updateImage(false), updateCloud(false), running(false), queueSize(5), nh(node), spinner(0), it(nh), rate_(rate)
+          updateImage(false), updateCloud(false), updateLookup(false), running(false), queueSize(5), nh(node), rate_(rate),
+          framePolicy(FramePolicy::LatestOnly), frameQueueSize(1), frameSeq(0), cloudSeq(0), lastConsumedSeq(0),
+          pyramidLevels(0), pyramidMode(PyramidMode::MinPool), updatePyramid(false), levels(kMaxPyramidLevel + 1)
     {
         cameraMatrixColor = cv::Mat::zeros(3, 3, CV_64F);
         cameraMatrixDepth = cv::Mat::zeros(3, 3, CV_64F);
@@ -59,10 +101,96 @@ public:
         start();
     }
 
+    // 由外部(如nodelet管理器)负责spin时调用, 点云线程仍由接收器自己创建; 需在run()之前调用
+    void setExternalSpin(bool external) { externalSpin = external; }
+
+    // 外部停止标志(如 nodelet 卸载时置位), 置位后 run() 不再等待首帧; 需在run()之前调用
+    void setStopFlag(const std::atomic<bool> *stop) { stopFlag = stop; }
+
+    // 由 ReceiverManager 托管: 回调进入共享队列, 点云转换由共享线程池调用 processPending() 完成, 需在run()之前调用
+    void host(ros::CallbackQueue *queue, std::function<void()> notify)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        hostQueue = queue;
+        frameNotify = std::move(notify);
+    }
+
+    bool isHosted() const { return hostQueue != nullptr; }
+
+    // 是否有待转换的帧, 不加锁, 可在管理器持有自身锁时调用
+    bool hasPendingFrame() const { return running && updateCloud; }
+
+    // 转换一帧待处理数据(非阻塞), 无待处理帧时返回false; 同一接收器不可并发调用
+    bool processPending()
+    {
+        CameraFrame frame;
+        if (!popFrame(frame))
+            return false;
+
+        convertFrame(frame);
+        if ((ros::Time::now() - lastDiagnosticsTime).toSec() >= 1.0)
+        {
+            publishDiagnostics();
+        }
+        return true;
+    }
+
+    // 检测器申请所需的降采样层(0为原始分辨率), 接收器会生成0..level的所有层
+    void requestPyramidLevel(int level, PyramidMode mode = PyramidMode::MinPool)
+    {
+        level = std::min(std::max(level, 0), kMaxPyramidLevel);
+        std::lock_guard<std::mutex> guard(lock);
+        if (level > pyramidLevels || mode != pyramidMode)
+        {
+            pyramidLevels = std::max<int>(level, pyramidLevels);
+            pyramidMode = mode;
+            updatePyramid = true;
+        }
+    }
+
+    int getPyramidLevels() { return pyramidLevels; };
+
+    // 第 level 层数据, level 为0时与 getColor()/getDepth()/getCloud() 等一致; 转换线程会替换其中的指针, 因此返回拷贝
+    CloudLevel getLevel(int level)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return levels.at(level);
+    };
+
+    // 最新一帧的只读数据, 尚无点云时为空
+    CloudFramePtr getFrame()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return latestFrame;
+    }
+
+    // 等待序号大于 seq 的帧, 超时返回空并计入 stats.idle(原先按固定频率轮询时会重复处理旧帧的轮次)
+    CloudFramePtr waitForFrame(uint64_t seq, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        if (!cloudCond.wait_for(guard, timeout, [this, seq] { return cloudSeq > seq || !ros::ok(); }) || cloudSeq <= seq)
+        {
+            ++stats.idle;
+            return CloudFramePtr();
+        }
+        return latestFrame;
+    }
+
+    // 设置帧缓冲策略, 需在run()之前调用; queue_size 仅对 BoundedQueue 有效
+    void setFramePolicy(FramePolicy policy, size_t queue_size = 3)
+    {
+        framePolicy = policy;
+        frameQueueSize = policy == FramePolicy::LatestOnly ? 1 : std::max<size_t>(queue_size, 1);
+    }
+
     void stop()
     {
         running = false;
-        spinner.stop();
+        queueCond.notify_all();
+        if (spinner)
+        {
+            spinner->stop();
+        }
         sleep(2);
 
         if (useExact)
@@ -82,15 +210,85 @@ public:
         printf("[INFO] Realsense receiver stopped.\n");
     }
 
-    const cv::Mat &getColor() { return color; };
-    const cv::Mat &getDepth() { return depth; };
-    const pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &getCloud() { return cloud; };
+    // 以下返回值在锁内拷贝(只增加引用计数): 回调与转换线程会替换这些成员;
+    // 需要彩色图、深度图与点云属于同一帧时使用 getFrame()/waitForFrame()
+    cv::Mat getColor()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return color;
+    };
+    cv::Mat getDepth()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return depth;
+    };
+    pcl::PointCloud<pcl::PointXYZRGBA>::Ptr getCloud()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return cloud;
+    };
+
+    // 当前点云对应的帧序号, 0 表示尚无点云
+    uint64_t getCloudSeq() { return cloudSeq; };
+
+    // 当前点云对应图像的时间戳, 用于按时间查询相机位姿
+    ros::Time getCloudStamp()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return cloudStamp;
+    };
+
+    // 等待序号大于 seq 的点云生成, 超时返回false
+    bool waitForCloud(uint64_t seq, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        return cloudCond.wait_for(guard, timeout, [this, seq] { return cloudSeq > seq || !ros::ok(); }) && cloudSeq > seq;
+    }
+
+    // 当前点云所用的深度图(已配准), 与 getCloud() 对应同一帧
+    cv::Mat getCloudDepth()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return cloudDepth;
+    };
+
+    // 检测器每次使用点云后调用, 用于统计重复处理的帧
+    void markConsumed(uint64_t seq)
+    {
+        if (seq == lastConsumedSeq.exchange(seq))
+            ++stats.reprocessed;
+        else
+            ++stats.consumed;
+    }
+
+    const FrameStats &getStats() const { return stats; };
 
-    const cv::Mat &getLookupX() { return lookupX; };
-    const cv::Mat &getLookupY() { return lookupY; };
+    // 逐像素的归一化射线表 (height x width, CV_32F), 已包含畸变校正: x = lookupX(r, c) * z, y = lookupY(r, c) * z
+    cv::Mat getLookupX()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return lookupX;
+    };
+    cv::Mat getLookupY()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return lookupY;
+    };
 
 protected:
     virtual void createCloud(const cv::Mat &depth, const cv::Mat &color, pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloud)
+    {
+        createCloud(depth, color, lookupX, lookupY, cloud);
+    }
+
+    // 生成点云前对深度图的处理(如在主机端配准到彩色图像), 默认直接使用
+    virtual cv::Mat alignDepth(const cv::Mat &depth)
+    {
+        return depth;
+    }
+
+    static void createCloud(const cv::Mat &depth, const cv::Mat &color, const cv::Mat &lookupX, const cv::Mat &lookupY,
+                            pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloud)
     {
         const float badPoint = std::numeric_limits<float>::quiet_NaN();
 
@@ -100,10 +298,10 @@ protected:
             pcl::PointXYZRGBA *itP = &cloud->points[r * depth.cols];
             const uint16_t *itD = depth.ptr<uint16_t>(r);
             const cv::Vec3b *itC = color.ptr<cv::Vec3b>(r);
-            const float y = lookupY.at<float>(0, r);
-            const float *itX = lookupX.ptr<float>();
+            const float *itX = lookupX.ptr<float>(r);
+            const float *itY = lookupY.ptr<float>(r);
 
-            for (size_t c = 0; c < (size_t)depth.cols; ++c, ++itP, ++itD, ++itC, ++itX)
+            for (size_t c = 0; c < (size_t)depth.cols; ++c, ++itP, ++itD, ++itC, ++itX, ++itY)
             {
                 register const float depthValue = *itD / 1000.0f;
                 // Check for invalid measurements
@@ -116,7 +314,7 @@ protected:
                 }
                 itP->z = depthValue;
                 itP->x = *itX * depthValue;
-                itP->y = y * depthValue;
+                itP->y = *itY * depthValue;
                 itP->b = itC->val[0];
                 itP->g = itC->val[1];
                 itP->r = itC->val[2];
@@ -133,16 +331,27 @@ private:
         std::string topicCameraInfoColor = topicColor.substr(0, topicColor.rfind('/')) + "/camera_info";
         std::string topicCameraInfoDepth = topicDepth.substr(0, topicDepth.rfind('/')) + "/camera_info";
 
+        if (hostQueue)
+        {
+            nh.setCallbackQueue(hostQueue);
+        }
+        it.reset(new image_transport::ImageTransport(nh));
+
         image_transport::TransportHints hints(useCompressed ? "compressed" : "raw");
         std::cout << topicColor << endl;
         std::cout << topicDepth << endl;
         std::cout << topicCameraInfoColor << endl;
         std::cout << topicCameraInfoDepth << endl;
-        subImageColor = new image_transport::SubscriberFilter(it, topicColor, queueSize, hints);
-        subImageDepth = new image_transport::SubscriberFilter(it, topicDepth, queueSize, hints);
+        subImageColor = new image_transport::SubscriberFilter(*it, topicColor, queueSize, hints);
+        subImageDepth = new image_transport::SubscriberFilter(*it, topicDepth, queueSize, hints);
         subCameraInfoColor = new message_filters::Subscriber<sensor_msgs::CameraInfo>(nh, topicCameraInfoColor, queueSize);
         subCameraInfoDepth = new message_filters::Subscriber<sensor_msgs::CameraInfo>(nh, topicCameraInfoDepth, queueSize);
 
+        // 统计进入同步器之前的原始消息数
+        subImageColor->registerCallback(boost::bind(&CameraReceiver::countColor, this, _1));
+        subImageDepth->registerCallback(boost::bind(&CameraReceiver::countDepth, this, _1));
+        pubDiagnostics = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+
         if (useExact)
         {
             syncExact = new message_filters::Synchronizer<ExactSyncPolicy>(ExactSyncPolicy(queueSize), *subImageColor, *subImageDepth, *subCameraInfoColor, *subCameraInfoDepth);
@@ -154,12 +363,17 @@ private:
             syncApproximate->registerCallback(boost::bind(&CameraReceiver::callback, this, _1, _2, _3, _4));
         }
 
-        spinner.start();
+        // 托管模式下由 ReceiverManager 统一 spin, nodelet 中由管理器 spin
+        if (!hostQueue && !externalSpin)
+        {
+            spinner.reset(new ros::AsyncSpinner(0));
+            spinner->start();
+        }
 
         std::chrono::milliseconds duration(1);
         while (!updateImage || !updateCloud)
         {
-            if (!ros::ok())
+            if (!ros::ok() || (stopFlag && *stopFlag))
             {
                 return;
             }
@@ -176,6 +390,12 @@ private:
         std::cout << this->color.cols << "," << this->color.rows << endl;
         std::cout << this->depth.cols << "," << this->depth.rows << endl;
 
+        lastDiagnosticsTime = ros::Time::now();
+        if (hostQueue)
+        {
+            return; // 托管模式下不创建独立的点云线程
+        }
+
         //        cloudViewer(); // 显示点云, 调试用
         cloudReceiverThread = std::thread(&CameraReceiver::cloudReceiver, this); // 获取和生成点云
         cloudReceiverThread.detach();                                            // 将子线程从主线程里分离,子线程执行完成后会自己释放掉资源
@@ -185,48 +405,371 @@ private:
                   const sensor_msgs::CameraInfo::ConstPtr &cameraInfoColor, const sensor_msgs::CameraInfo::ConstPtr &cameraInfoDepth)
     {
         cv::Mat color, depth;
+        cv_bridge::CvImageConstPtr depthHolder;
 
-        readCameraInfo(cameraInfoColor, cameraMatrixColor);
-        readCameraInfo(cameraInfoDepth, cameraMatrixDepth);
+        const ros::Time received = ros::Time::now();
         readRgbImage(imageColor, color);
-        readDepthImage(imageDepth, depth);
+        readDepthImage(imageDepth, depth, depthHolder);
 
         // std::cout << "debug" << endl;
 
         lock.lock();
+        // 仅在CameraInfo变化时更新内参并标记重建查找表
+        if (cameraInfoChanged(*cameraInfoColor, this->cameraInfoColor))
+        {
+            this->cameraInfoColor = *cameraInfoColor;
+            readCameraInfo(cameraInfoColor, topicColor, cameraMatrixColor, distCoeffsColor);
+            updateLookup = true;
+            ++cameraInfoVersion;
+        }
+        if (cameraInfoChanged(*cameraInfoDepth, this->cameraInfoDepth))
+        {
+            this->cameraInfoDepth = *cameraInfoDepth;
+            readCameraInfo(cameraInfoDepth, topicDepth, cameraMatrixDepth, distCoeffsDepth);
+            ++cameraInfoVersion;
+        }
         this->color = color;
         this->depth = depth;
-        updateImage = true;
-        updateCloud = true;
+        this->depthHolder = depthHolder;
         lock.unlock();
 
+        CameraFrame frame;
+        frame.seq = ++frameSeq;
+        frame.stamp = imageColor->header.stamp;
+        frame.color = color;
+        frame.depth = depth;
+        frame.holder = depthHolder;
+        ++stats.synced;
+        updateLatency(stats.receive_latency_ms, (received - frame.stamp).toSec() * 1000.0);
+
+        pushFrame(frame);
+
         //        ROS_INFO("Received new image and depth.");
     }
 
-    void cloudReceiver()
+    void countColor(const sensor_msgs::Image::ConstPtr &) { ++stats.received_color; }
+    void countDepth(const sensor_msgs::Image::ConstPtr &) { ++stats.received_depth; }
+
+    void pushFrame(const CameraFrame &frame)
     {
-        cv::Mat color, depth;
+        std::unique_lock<std::mutex> guard(lock);
+        if (framePolicy == FramePolicy::BoundedQueue && frameQueue.size() >= frameQueueSize)
+        {
+            // 反压: 最多等待一个采集周期, 仍然满则丢弃最旧帧
+            queueCond.wait_for(guard, std::chrono::milliseconds(1000 / std::max(rate_, 1)),
+                               [this] { return frameQueue.size() < frameQueueSize || !running; });
+        }
+        while (frameQueue.size() >= frameQueueSize)
+        {
+            frameQueue.pop_front();
+            ++stats.dropped;
+        }
+        frameQueue.push_back(frame);
+        updateImage = true;
+        updateCloud = true;
+        const std::function<void()> notify = frameNotify;
+        guard.unlock();
+
+        // 在锁外通知, 管理器的锁与本接收器的锁不嵌套
+        if (notify)
+        {
+            notify();
+        }
+    }
+
+    bool popFrame(CameraFrame &frame)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (frameQueue.empty())
+            return false;
+        frame = frameQueue.front();
+        frameQueue.pop_front();
+        updateCloud = !frameQueue.empty();
+        queueCond.notify_one();
+        return true;
+    }
+
+    void convertFrame(const CameraFrame &frame)
+    {
+        if (updateLookup)
+        {
+            createLookup(frame.color.cols, frame.color.rows);
+        }
+
+        const cv::Mat depth = alignDepth(frame.depth);
+        std::shared_ptr<CloudFrame> out = acquireCloudFrame();
+        CloudLevel &base = out->levels[0];
+        resizeCloud(base.cloud, frame.color.cols, frame.color.rows);
+        createCloud(depth, frame.color, base.cloud);
+        if (pyramidLevels > 0)
+        {
+            createPyramid(depth, frame.color, *out);
+        }
+        base.scale = 1;
+        base.color = frame.color;
+        base.depth = depth;
+        // 配准后的深度图由本帧持有; 否则仍指向消息数据, 需随本帧一起持有消息
+        out->holder = depth.data == frame.depth.data ? frame.holder : boost::shared_ptr<const void>();
+        out->seq = frame.seq;
+        out->stamp = frame.stamp;
 
         lock.lock();
-        color = this->color;
-        depth = this->depth;
-        updateCloud = false;
+        base.lookupX = lookupX;
+        base.lookupY = lookupY;
+        base.cameraMatrix = cameraMatrixColor;
+        // 兼容 getCloud()/getLevel(): 指向最新一帧的缓存
+        cloud = base.cloud;
+        levels[0].color = base.color;
+        levels[0].depth = base.depth;
+        levels[0].cloud = base.cloud;
+        for (size_t l = 1; l < out->levels.size() && l < levels.size(); l++)
+        {
+            levels[l].color = out->levels[l].color;
+            levels[l].depth = out->levels[l].depth;
+            levels[l].cloud = out->levels[l].cloud;
+        }
+        latestFrame = out;
+        cloudStamp = frame.stamp;
+        cloudDepth = depth;
+        cloudSeq = frame.seq;
         lock.unlock();
+        cloudCond.notify_all();
+        ++stats.converted;
+        updateLatency(stats.convert_latency_ms, (ros::Time::now() - frame.stamp).toSec() * 1000.0);
+    }
 
-        createCloud(depth, color, cloud);
+    // 延迟的指数滑动平均
+    static void updateLatency(std::atomic<double> &latency, double value_ms)
+    {
+        const double last = latency;
+        latency = last == 0 ? value_ms : 0.9 * last + 0.1 * value_ms;
+    }
+
+    // 按当前查找表与内参生成各层的射线表、内参和点云缓存, 仅在查找表或层数变化时调用
+    void createPyramidLookup(int width, int height)
+    {
+        lock.lock();
+        const int numLevels = pyramidLevels;
+        const PyramidMode mode = pyramidMode;
+        cv::Mat cameraMatrix = cameraMatrixColor.clone();
+        cv::Mat fullX = lookupX, fullY = lookupY;
+        updatePyramid = false;
+        lock.unlock();
+
+        levels[0].scale = 1;
+        levels[0].lookupX = fullX;
+        levels[0].lookupY = fullY;
+        levels[0].cameraMatrix = cameraMatrix;
+
+        for (int l = 1; l <= numLevels; l++)
+        {
+            CloudLevel &level = levels[l];
+            level.scale = 1 << l;
+            const int s = level.scale;
+            const cv::Size size(width / s, height / s);
+            const int interp = mode == PyramidMode::Stride ? cv::INTER_NEAREST : cv::INTER_AREA;
+
+            // 隔点采样取块左上角像素的射线, 池化取块内射线均值(即块中心)
+            cv::resize(fullX(cv::Rect(0, 0, size.width * s, size.height * s)), level.lookupX, size, 0, 0, interp);
+            cv::resize(fullY(cv::Rect(0, 0, size.width * s, size.height * s)), level.lookupY, size, 0, 0, interp);
+
+            level.cameraMatrix = cameraMatrix.clone();
+            level.cameraMatrix.at<double>(0, 0) /= s;
+            level.cameraMatrix.at<double>(1, 1) /= s;
+            if (mode == PyramidMode::Stride)
+            {
+                level.cameraMatrix.at<double>(0, 2) /= s;
+                level.cameraMatrix.at<double>(1, 2) /= s;
+            }
+            else
+            {
+                level.cameraMatrix.at<double>(0, 2) = (cameraMatrix.at<double>(0, 2) + 0.5) / s - 0.5;
+                level.cameraMatrix.at<double>(1, 2) = (cameraMatrix.at<double>(1, 2) + 0.5) / s - 0.5;
+            }
+        }
+    }
+
+    // 各降采样层写入 out.levels[1..], 射线表与内参取自 levels
+    void createPyramid(const cv::Mat &depth, const cv::Mat &color, CloudFrame &out)
+    {
+        if (updatePyramid || levels[0].lookupX.data != lookupX.data)
+        {
+            createPyramidLookup(color.cols, color.rows);
+        }
+
+        int l = 1;
+        for (; l <= pyramidLevels && !levels[l].lookupX.empty(); l++)
+        {
+            const CloudLevel &geometry = levels[l];
+            if ((int)out.levels.size() <= l)
+            {
+                out.levels.resize(l + 1);
+            }
+            CloudLevel &level = out.levels[l];
+            const cv::Size size(geometry.lookupX.cols, geometry.lookupX.rows);
+            const int interp = pyramidMode == PyramidMode::Stride ? cv::INTER_NEAREST : cv::INTER_AREA;
+
+            cv::Mat levelColor, levelDepth;
+            cv::resize(color(cv::Rect(0, 0, size.width * geometry.scale, size.height * geometry.scale)), levelColor, size, 0, 0, interp);
+            downsampleDepth(depth, levelDepth, geometry.scale, pyramidMode);
+            resizeCloud(level.cloud, size.width, size.height);
+            createCloud(levelDepth, levelColor, geometry.lookupX, geometry.lookupY, level.cloud);
+
+            level.scale = geometry.scale;
+            level.lookupX = geometry.lookupX;
+            level.lookupY = geometry.lookupY;
+            level.cameraMatrix = geometry.cameraMatrix;
+            level.color = levelColor;
+            level.depth = levelDepth;
+        }
+        out.levels.resize(l);
+    }
+
+    // 从缓存池取一帧: 只有池本身持有(检测器均已释放)的帧才会被改写, 否则新分配一帧加入池中,
+    // 池的大小因此等于同时被持有的帧数的峰值
+    std::shared_ptr<CloudFrame> acquireCloudFrame()
+    {
+        for (const std::shared_ptr<CloudFrame> &frame : framePool)
+        {
+            if (frame.use_count() != 1)
+            {
+                continue;
+            }
+            bool borrowed = false;
+            for (const CloudLevel &level : frame->levels)
+            {
+                borrowed = borrowed || (level.cloud && level.cloud.use_count() != 1);
+            }
+            if (!borrowed)
+            {
+                return frame;
+            }
+        }
+        framePool.push_back(std::make_shared<CloudFrame>());
+        framePool.back()->levels.resize(1);
+        return framePool.back();
+    }
+
+    static void resizeCloud(pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloud, int width, int height)
+    {
+        if (!cloud)
+        {
+            cloud = pcl::PointCloud<pcl::PointXYZRGBA>::Ptr(new pcl::PointCloud<pcl::PointXYZRGBA>());
+        }
+        cloud->width = width;
+        cloud->height = height;
+        cloud->is_dense = false;
+        cloud->points.resize(width * height);
+    }
+
+    // 深度降采样, 0 视为无效值且不参与池化
+    static void downsampleDepth(const cv::Mat &src, cv::Mat &dst, int s, PyramidMode mode)
+    {
+        dst.create(src.rows / s, src.cols / s, CV_16UC1);
+
+#pragma omp parallel for
+        for (int r = 0; r < dst.rows; ++r)
+        {
+            uint16_t *itO = dst.ptr<uint16_t>(r);
+            uint16_t block[16];
+            for (int c = 0; c < dst.cols; ++c, ++itO)
+            {
+                if (mode == PyramidMode::Stride)
+                {
+                    *itO = src.at<uint16_t>(r * s, c * s);
+                    continue;
+                }
+
+                int n = 0;
+                for (int i = 0; i < s; ++i)
+                {
+                    const uint16_t *itD = src.ptr<uint16_t>(r * s + i) + c * s;
+                    for (int j = 0; j < s; ++j)
+                    {
+                        if (itD[j] != 0)
+                            block[n++] = itD[j];
+                    }
+                }
+
+                if (n == 0)
+                    *itO = 0;
+                else if (mode == PyramidMode::MinPool)
+                    *itO = *std::min_element(block, block + n);
+                else
+                {
+                    std::nth_element(block, block + n / 2, block + n);
+                    *itO = block[n / 2];
+                }
+            }
+        }
+    }
+
+    void publishDiagnostics()
+    {
+        const uint64_t converted = stats.converted;
+        const double dt = (ros::Time::now() - lastDiagnosticsTime).toSec();
+        const double convertRate = dt > 0 ? (converted - lastDiagnosticsConverted) / dt : 0;
+        lastDiagnosticsTime = ros::Time::now();
+        lastDiagnosticsConverted = converted;
+
+        diagnostic_msgs::DiagnosticStatus status;
+        status.name = ros::this_node::getName() + ": camera receiver (" + topicColor + ")";
+        status.hardware_id = topicColor;
+        status.level = stats.dropped > stats.converted ? diagnostic_msgs::DiagnosticStatus::WARN : diagnostic_msgs::DiagnosticStatus::OK;
+        status.message = stats.dropped > stats.converted ? "more frames dropped than converted" : "ok";
+
+        auto addValue = [&status](const std::string &key, double value) {
+            diagnostic_msgs::KeyValue kv;
+            kv.key = key;
+            std::ostringstream oss;
+            oss << value;
+            kv.value = oss.str();
+            status.values.push_back(kv);
+        };
+        addValue("policy_queue_size", frameQueueSize);
+        addValue("received_color", stats.received_color);
+        addValue("received_depth", stats.received_depth);
+        addValue("synced", stats.synced);
+        addValue("dropped", stats.dropped);
+        addValue("converted", stats.converted);
+        addValue("consumed", stats.consumed);
+        addValue("reprocessed", stats.reprocessed);
+        addValue("idle_waits", stats.idle);
+        addValue("frame_pool", framePool.size());
+        addValue("last_seq", cloudSeq);
+        addValue("convert_rate", convertRate);
+        addValue("receive_latency_ms", stats.receive_latency_ms);
+        addValue("convert_latency_ms", stats.convert_latency_ms);
+
+        diagnostic_msgs::DiagnosticArray array;
+        array.header.stamp = ros::Time::now();
+        array.status.push_back(status);
+        pubDiagnostics.publish(array);
+    }
 
+    void cloudReceiver()
+    {
+        CameraFrame frame;
+        if (popFrame(frame))
+        {
+            convertFrame(frame);
+        }
+
+        lastDiagnosticsTime = ros::Time::now();
         ros::Rate rate(rate_);
         for (; running && ros::ok();)
         {
-            if (updateCloud)
+            // 有界队列模式下连续处理积压帧, 最新帧模式下每周期至多一帧
+            while (updateCloud && popFrame(frame))
             {
-                lock.lock();
-                color = this->color;
-                depth = this->depth;
-                updateCloud = false;
-                lock.unlock();
+                convertFrame(frame);
+                if (framePolicy == FramePolicy::LatestOnly)
+                    break;
+            }
 
-                createCloud(depth, color, cloud);
+            if ((ros::Time::now() - lastDiagnosticsTime).toSec() >= 1.0)
+            {
+                publishDiagnostics();
             }
 
             rate.sleep();
@@ -282,47 +825,81 @@ private:
         cv::cvtColor(pCvImage->image, image, cv::COLOR_BGR2RGB);
     }
 
-    void readDepthImage(const sensor_msgs::Image::ConstPtr &msgImage, cv::Mat &image) const
+    // 深度图直接引用消息数据(nodelet进程内传输时全程无拷贝), 由 holder 保持消息的生命周期
+    void readDepthImage(const sensor_msgs::Image::ConstPtr &msgImage, cv::Mat &image, cv_bridge::CvImageConstPtr &holder) const
     {
-        cv_bridge::CvImageConstPtr pCvImage;
-        pCvImage = cv_bridge::toCvShare(msgImage, msgImage->encoding);
-        pCvImage->image.copyTo(image);
+        holder = cv_bridge::toCvShare(msgImage, msgImage->encoding);
+        image = holder->image;
     }
 
-    void readCameraInfo(const sensor_msgs::CameraInfo::ConstPtr &cameraInfo, cv::Mat &cameraMatrix) const
+    void readCameraInfo(const sensor_msgs::CameraInfo::ConstPtr &cameraInfo, const std::string &topic, cv::Mat &cameraMatrix, cv::Mat &distCoeffs) const
     {
         double *itC = cameraMatrix.ptr<double>(0, 0);
         for (size_t i = 0; i < 9; ++i, ++itC)
         {
             *itC = cameraInfo->K[i];
         }
+
+        // 已校正的话题(image_rect*)不再重复去畸变; 仅支持OpenCV可直接处理的畸变模型, 其余模型忽略畸变系数
+        if (topic.find("rect") != std::string::npos || topic.find("align") != std::string::npos)
+        {
+            distCoeffs = cv::Mat();
+        }
+        else if (cameraInfo->distortion_model == "plumb_bob" || cameraInfo->distortion_model == "rational_polynomial")
+        {
+            distCoeffs = cv::Mat(cameraInfo->D, true).reshape(1, 1);
+        }
+        else
+        {
+            if (!cameraInfo->D.empty())
+            {
+                printf("[WARN] Unsupported distortion model '%s', distortion is ignored.\n", cameraInfo->distortion_model.c_str());
+            }
+            distCoeffs = cv::Mat();
+        }
+    }
+
+    static bool cameraInfoChanged(const sensor_msgs::CameraInfo &cur, const sensor_msgs::CameraInfo &last)
+    {
+        return cur.width != last.width || cur.height != last.height ||
+               cur.distortion_model != last.distortion_model || cur.K != last.K || cur.D != last.D;
     }
 
     void createLookup(size_t width, size_t height)
     {
-        const float fx = 1.0f / cameraMatrixColor.at<double>(0, 0);
-        const float fy = 1.0f / cameraMatrixColor.at<double>(1, 1);
-        const float cx = cameraMatrixColor.at<double>(0, 2);
-        const float cy = cameraMatrixColor.at<double>(1, 2);
-        float *it;
+        cv::Mat cameraMatrix, distCoeffs;
+        lock.lock();
+        cameraMatrixColor.copyTo(cameraMatrix);
+        distCoeffsColor.copyTo(distCoeffs);
+        updateLookup = false;
+        lock.unlock();
 
-        lookupY = cv::Mat(1, height, CV_32F);
-        it = lookupY.ptr<float>();
-        for (size_t r = 0; r < height; ++r, ++it)
+        // 对整幅像素网格做一次完整的去畸变反投影, 结果为每个像素的 (x/z, y/z)
+        cv::Mat pixels(1, width * height, CV_32FC2);
+        cv::Vec2f *itP = pixels.ptr<cv::Vec2f>();
+        for (size_t r = 0; r < height; ++r)
         {
-            *it = (r - cy) * fy;
+            for (size_t c = 0; c < width; ++c, ++itP)
+            {
+                *itP = cv::Vec2f(c, r);
+            }
         }
 
-        lookupX = cv::Mat(1, width, CV_32F);
-        it = lookupX.ptr<float>();
-        for (size_t c = 0; c < width; ++c, ++it)
-        {
-            *it = (c - cx) * fx;
-        }
+        cv::Mat rays;
+        cv::undistortPoints(pixels, rays, cameraMatrix, distCoeffs);
+
+        cv::Mat xy[2];
+        cv::split(rays.reshape(2, height), xy);
+
+        lock.lock();
+        lookupX = xy[0];
+        lookupY = xy[1];
+        lock.unlock();
     }
 
 protected:
     cv::Mat color, depth;
+    cv_bridge::CvImageConstPtr depthHolder;
     pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloud;
     cv::Mat lookupX, lookupY;
 
@@ -331,19 +908,26 @@ protected:
     const std::string topicColor, topicDepth;
     const bool useExact, useCompressed;
 
-    bool running;
+    std::atomic<bool> running;
     const size_t queueSize;
-    bool updateImage, updateCloud;
+    std::atomic<bool> updateImage, updateCloud, updateLookup; // 回调线程在锁内写, 转换线程与管理器不加锁读
     int rate_;
 
     cv::Mat cameraMatrixColor, cameraMatrixDepth;
+    cv::Mat distCoeffsColor, distCoeffsDepth;
+    sensor_msgs::CameraInfo cameraInfoColor, cameraInfoDepth;
+    std::atomic<uint64_t> cameraInfoVersion{0}; // 任一相机内参/畸变变化时递增
 
     typedef message_filters::sync_policies::ExactTime<sensor_msgs::Image, sensor_msgs::Image, sensor_msgs::CameraInfo, sensor_msgs::CameraInfo> ExactSyncPolicy;
     typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::Image, sensor_msgs::Image, sensor_msgs::CameraInfo, sensor_msgs::CameraInfo> ApproximateSyncPolicy;
 
     ros::NodeHandle nh;
-    ros::AsyncSpinner spinner;
-    image_transport::ImageTransport it;
+    std::unique_ptr<ros::AsyncSpinner> spinner;
+    std::unique_ptr<image_transport::ImageTransport> it;
+    std::atomic<ros::CallbackQueue *> hostQueue{nullptr};
+    bool externalSpin = false;
+    const std::atomic<bool> *stopFlag = nullptr;
+    std::function<void()> frameNotify;
     image_transport::SubscriberFilter *subImageColor, *subImageDepth;
     message_filters::Subscriber<sensor_msgs::CameraInfo> *subCameraInfoColor, *subCameraInfoDepth;
 
@@ -352,5 +936,27 @@ protected:
 
     std::thread cloudReceiverThread;
 
+    // 帧缓冲与统计
+    FramePolicy framePolicy;
+    size_t frameQueueSize;
+    std::deque<CameraFrame> frameQueue;
+    std::condition_variable queueCond;
+    std::atomic<uint64_t> frameSeq, cloudSeq, lastConsumedSeq;
+    ros::Time cloudStamp;
+    cv::Mat cloudDepth;
+    std::condition_variable cloudCond;
+
+    // 降采样金字塔
+    std::atomic<int> pyramidLevels;
+    PyramidMode pyramidMode;
+    std::atomic<bool> updatePyramid; // 检测线程在锁内写, 转换线程不加锁读
+    std::vector<CloudLevel> levels; // 各层射线表与内参, 图像与点云指向最新一帧
+    std::vector<std::shared_ptr<CloudFrame>> framePool; // 只在转换线程中访问
+    CloudFramePtr latestFrame;
+    FrameStats stats;
+    ros::Publisher pubDiagnostics;
+    ros::Time lastDiagnosticsTime;
+    uint64_t lastDiagnosticsConverted = 0;
+
     std::vector<int> params;
 };
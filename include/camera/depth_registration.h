@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+// 深度图配准到彩色相机: 对每个深度像素预先计算仿射系数, 运行时每像素只需3次乘加和1次倒数,
+// 按行并行并向量化计算目标像素, 冲突像素用原子最小值z-buffer保留最近点
+class DepthRegistration
+{
+public:
+    static const uint16_t kEmpty = 0xFFFF; // z-buffer 中的空像素
+
+    DepthRegistration() : initialized_(false), depthScale_(1000.0f), holeFill_(true), maxHoleGap_(20) {}
+
+    // cameraMatrixDepth/distCoeffsDepth: 深度相机内参与畸变; cameraMatrixColor: 彩色相机内参
+    // rotation/translation: 深度坐标系到彩色坐标系的变换(米); depthScale: 深度值每米对应的单位数(毫米为1000)
+    // 参数与上次相同时不重建系数表, 返回是否重建
+    bool init(const cv::Mat &cameraMatrixDepth, const cv::Mat &distCoeffsDepth, const cv::Size &sizeDepth,
+              const cv::Mat &cameraMatrixColor, const cv::Size &sizeColor,
+              const cv::Matx33d &rotation, const cv::Vec3d &translation, float depthScale = 1000.0f)
+    {
+        if (initialized_ && sizeDepth == sizeDepth_ && sizeColor == sizeColor_ && depthScale == depthScale_ &&
+            rotation == rotation_ && translation == translation_ &&
+            sameMat(cameraMatrixDepth, cameraMatrixDepth_) && sameMat(distCoeffsDepth, distCoeffsDepth_) &&
+            sameMat(cameraMatrixColor, cameraMatrixColor_))
+        {
+            return false;
+        }
+
+        cameraMatrixDepth.copyTo(cameraMatrixDepth_);
+        distCoeffsDepth.copyTo(distCoeffsDepth_);
+        cameraMatrixColor.copyTo(cameraMatrixColor_);
+        sizeDepth_ = sizeDepth;
+        sizeColor_ = sizeColor;
+        rotation_ = rotation;
+        translation_ = translation;
+        depthScale_ = depthScale;
+
+        // 深度像素的去畸变射线 (x, y, 1)
+        cv::Mat pixels(1, sizeDepth.area(), CV_32FC2);
+        cv::Vec2f *itP = pixels.ptr<cv::Vec2f>();
+        for (int r = 0; r < sizeDepth.height; ++r)
+        {
+            for (int c = 0; c < sizeDepth.width; ++c, ++itP)
+            {
+                *itP = cv::Vec2f(c, r);
+            }
+        }
+        cv::Mat rays;
+        cv::undistortPoints(pixels, rays, cameraMatrixDepth, distCoeffsDepth);
+        rays = rays.reshape(2, sizeDepth.height);
+
+        const double fx = cameraMatrixColor.at<double>(0, 0), fy = cameraMatrixColor.at<double>(1, 1);
+        const double cx = cameraMatrixColor.at<double>(0, 2), cy = cameraMatrixColor.at<double>(1, 2);
+        const cv::Matx33d &R = rotation;
+        const cv::Vec3d &t = translation;
+
+        // 彩色相机下 P = z*R*ray + t, 投影 u = (z*A + tu) / (z*C + tz), v = (z*B + tv) / (z*C + tz)
+        coeffA_.create(sizeDepth, CV_32F);
+        coeffB_.create(sizeDepth, CV_32F);
+        coeffC_.create(sizeDepth, CV_32F);
+        for (int r = 0; r < sizeDepth.height; ++r)
+        {
+            const cv::Vec2f *itR = rays.ptr<cv::Vec2f>(r);
+            float *itA = coeffA_.ptr<float>(r), *itB = coeffB_.ptr<float>(r), *itC = coeffC_.ptr<float>(r);
+            for (int c = 0; c < sizeDepth.width; ++c)
+            {
+                const cv::Vec3d ray = R * cv::Vec3d(itR[c][0], itR[c][1], 1.0);
+                itA[c] = (float)(fx * ray[0] + cx * ray[2]);
+                itB[c] = (float)(fy * ray[1] + cy * ray[2]);
+                itC[c] = (float)ray[2];
+            }
+        }
+        tu_ = (float)(fx * t[0] + cx * t[2]);
+        tv_ = (float)(fy * t[1] + cy * t[2]);
+        tz_ = (float)t[2];
+
+        target_.create(sizeDepth, CV_32S);
+        targetZ_.create(sizeDepth, CV_16UC1);
+        zbuffer_.create(sizeColor, CV_16UC1);
+        initialized_ = true;
+
+        printf("[INFO] DepthRegistration: %dx%d -> %dx%d tables rebuilt.\n",
+               sizeDepth.width, sizeDepth.height, sizeColor.width, sizeColor.height);
+        return true;
+    }
+
+    bool isInitialized() const { return initialized_; }
+
+    // 当前系数表对应的深度图尺寸
+    const cv::Size &depthSize() const { return sizeDepth_; }
+
+    // 是否填补单像素空洞, maxGap: 两侧深度差不超过该值(深度单位)时才填补, 避免跨越物体边缘
+    void setHoleFill(bool fill, uint16_t maxGap = 20)
+    {
+        holeFill_ = fill;
+        maxHoleGap_ = maxGap;
+    }
+
+    // 将 CV_16UC1 深度图配准到彩色图像平面, 输出为彩色分辨率的新图像, 无效像素为0
+    void registerDepth(const cv::Mat &depth, cv::Mat &registered)
+    {
+        CV_Assert(initialized_ && depth.type() == CV_16UC1 && depth.size() == sizeDepth_);
+
+        const int colsC = sizeColor_.width, rowsC = sizeColor_.height;
+        const float maxU = colsC - 0.5f, maxV = rowsC - 0.5f;
+        const float invScale = 1.0f / depthScale_;
+        const float tu = tu_, tv = tv_, tz = tz_, scale = depthScale_;
+
+        zbuffer_.setTo(cv::Scalar(kEmpty));
+
+        // 1. 计算每个深度像素在彩色图像中的目标位置与深度, 越界/无效为-1
+#pragma omp parallel for
+        for (int r = 0; r < depth.rows; ++r)
+        {
+            const uint16_t *itD = depth.ptr<uint16_t>(r);
+            const float *itA = coeffA_.ptr<float>(r), *itB = coeffB_.ptr<float>(r), *itC = coeffC_.ptr<float>(r);
+            int32_t *itT = target_.ptr<int32_t>(r);
+            uint16_t *itZ = targetZ_.ptr<uint16_t>(r);
+
+#pragma omp simd
+            for (int c = 0; c < depth.cols; ++c)
+            {
+                const float z = itD[c] * invScale;
+                const float zc = z * itC[c] + tz;
+                const float inv = 1.0f / zc;
+                const float u = (z * itA[c] + tu) * inv;
+                const float v = (z * itB[c] + tv) * inv;
+                const float zcScaled = zc * scale + 0.5f;
+                // 在浮点域判断边界, 不会因整数截断回绕
+                const bool valid = itD[c] != 0 && zc > 0.0f && u >= -0.5f && u < maxU && v >= -0.5f && v < maxV &&
+                                   zcScaled < (float)kEmpty;
+                // 先钳位再取整, 越界或NaN不会产生未定义的整数转换
+                const int ui = (int)(std::min(maxU, std::max(0.0f, u)) + 0.5f);
+                const int vi = (int)(std::min(maxV, std::max(0.0f, v)) + 0.5f);
+                itT[c] = valid ? vi * colsC + ui : -1;
+                itZ[c] = valid ? (uint16_t)std::max(zcScaled, 1.0f) : kEmpty;
+            }
+        }
+
+        // 2. 散射写入z-buffer, 多个深度像素落到同一彩色像素时保留最近的
+        uint16_t *zbuf = zbuffer_.ptr<uint16_t>();
+#pragma omp parallel for
+        for (int r = 0; r < depth.rows; ++r)
+        {
+            const int32_t *itT = target_.ptr<int32_t>(r);
+            const uint16_t *itZ = targetZ_.ptr<uint16_t>(r);
+            for (int c = 0; c < depth.cols; ++c)
+            {
+                if (itT[c] >= 0)
+                {
+                    atomicMin(zbuf + itT[c], itZ[c]);
+                }
+            }
+        }
+
+        // 3. 输出, 可选填补左右或上下两侧深度相近的单像素空洞
+        registered.create(sizeColor_, CV_16UC1);
+        const bool fill = holeFill_;
+        const int maxGap = maxHoleGap_;
+#pragma omp parallel for
+        for (int r = 0; r < rowsC; ++r)
+        {
+            const uint16_t *itZ = zbuffer_.ptr<uint16_t>(r);
+            const uint16_t *itUp = zbuffer_.ptr<uint16_t>(std::max(r - 1, 0));
+            const uint16_t *itDown = zbuffer_.ptr<uint16_t>(std::min(r + 1, rowsC - 1));
+            uint16_t *itO = registered.ptr<uint16_t>(r);
+            for (int c = 0; c < colsC; ++c)
+            {
+                uint16_t value = itZ[c];
+                if (value == kEmpty && fill && c > 0 && c < colsC - 1 && r > 0 && r < rowsC - 1)
+                {
+                    value = fillValue(itZ[c - 1], itZ[c + 1], maxGap);
+                    if (value == kEmpty)
+                    {
+                        value = fillValue(itUp[c], itDown[c], maxGap);
+                    }
+                }
+                itO[c] = value == kEmpty ? 0 : value;
+            }
+        }
+    }
+
+private:
+    static bool sameMat(const cv::Mat &a, const cv::Mat &b)
+    {
+        if (a.empty() || b.empty())
+            return a.empty() && b.empty();
+        return a.size() == b.size() && a.type() == b.type() && cv::norm(a, b, cv::NORM_INF) == 0;
+    }
+
+    static inline void atomicMin(uint16_t *addr, uint16_t value)
+    {
+        uint16_t current = __atomic_load_n(addr, __ATOMIC_RELAXED);
+        while (value < current &&
+               !__atomic_compare_exchange_n(addr, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+        }
+    }
+
+    static inline uint16_t fillValue(uint16_t a, uint16_t b, int maxGap)
+    {
+        if (a == kEmpty || b == kEmpty || std::abs((int)a - (int)b) > maxGap)
+            return kEmpty;
+        return (uint16_t)(((int)a + (int)b) / 2);
+    }
+
+private:
+    bool initialized_;
+    cv::Mat cameraMatrixDepth_, distCoeffsDepth_, cameraMatrixColor_;
+    cv::Size sizeDepth_, sizeColor_;
+    cv::Matx33d rotation_;
+    cv::Vec3d translation_;
+    float depthScale_;
+
+    cv::Mat coeffA_, coeffB_, coeffC_; // 每个深度像素的投影系数
+    float tu_, tv_, tz_;
+
+    cv::Mat target_;  // 每个深度像素的目标彩色像素索引
+    cv::Mat targetZ_; // 目标像素处的深度
+    cv::Mat zbuffer_;
+
+    bool holeFill_;
+    int maxHoleGap_;
+};
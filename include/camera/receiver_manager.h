@@ -0,0 +1,197 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <ros/ros.h>
+#include <ros/spinner.h>
+#include <ros/callback_queue.h>
+
+#include "camera/camera_receiver.h"
+
+// 多相机接收管理: N 路相机共用一个回调队列、一个有界的 spin 线程组和一个点云转换线程池,
+// 避免每个 CameraReceiver 各自启动 AsyncSpinner(0) 与点云线程导致 CPU 过载
+class ReceiverManager
+{
+public:
+    // spin_threads: 处理ROS回调的线程数; worker_threads: 点云转换线程数; omp_threads: 每次转换内部的OpenMP线程数
+    ReceiverManager(int spin_threads = 1, int worker_threads = 2, int omp_threads = 1)
+        : spin_threads_(std::max(spin_threads, 1)), worker_threads_(std::max(worker_threads, 1)),
+          omp_threads_(std::max(omp_threads, 1)), running_(false)
+    {
+    }
+
+    ~ReceiverManager()
+    {
+        stop();
+    }
+
+    // 添加一路相机, priority 越大越优先转换; 需在start()之前调用
+    void addStream(std::shared_ptr<CameraReceiver> receiver, int priority = 0)
+    {
+        Stream stream;
+        stream.receiver = receiver;
+        stream.priority = priority;
+        streams_.push_back(stream);
+
+        receiver->host(&callback_queue_, [this] {
+            std::lock_guard<std::mutex> guard(mutex_);
+            cond_.notify_one();
+        });
+    }
+
+    // 启动共享 spin 线程, 等待各路相机首帧, 再启动转换线程池
+    void start()
+    {
+        if (running_)
+            return;
+        running_ = true;
+
+        callback_queue_.enable();
+        spinner_.reset(new ros::AsyncSpinner(spin_threads_, &callback_queue_));
+        spinner_->start();
+
+        for (auto &stream : streams_)
+        {
+            stream.receiver->run();
+        }
+
+        for (int i = 0; i < worker_threads_; i++)
+        {
+            workers_.emplace_back(&ReceiverManager::workerLoop, this);
+        }
+
+        printf("[INFO] ReceiverManager started: %zu streams, %d spin threads, %d workers.\n",
+               streams_.size(), spin_threads_, worker_threads_);
+    }
+
+    void stop()
+    {
+        if (!running_)
+            return;
+
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            running_ = false;
+        }
+        cond_.notify_all();
+        for (auto &worker : workers_)
+        {
+            if (worker.joinable())
+                worker.join();
+        }
+        workers_.clear();
+
+        // 先停 spin 线程并丢弃未执行的回调, 再销毁各路订阅与同步器, 避免回调在析构中的对象上执行
+        if (spinner_)
+        {
+            spinner_->stop();
+        }
+        callback_queue_.disable();
+        callback_queue_.clear();
+        for (auto &stream : streams_)
+        {
+            stream.receiver->stop();
+        }
+    }
+
+    size_t size() const { return streams_.size(); }
+
+    std::shared_ptr<CameraReceiver> getReceiver(size_t index) { return streams_.at(index).receiver; }
+
+    // 所有相机已转换的总帧数
+    uint64_t totalConverted() const
+    {
+        uint64_t total = 0;
+        for (const auto &stream : streams_)
+            total += stream.receiver->getStats().converted;
+        return total;
+    }
+
+    uint64_t totalDropped() const
+    {
+        uint64_t total = 0;
+        for (const auto &stream : streams_)
+            total += stream.receiver->getStats().dropped;
+        return total;
+    }
+
+private:
+    struct Stream
+    {
+        std::shared_ptr<CameraReceiver> receiver;
+        int priority = 0;
+        bool busy = false;       // 同一路相机同一时刻只能由一个线程转换
+        uint64_t last_serve = 0; // 同优先级时先服务等待最久的一路
+    };
+
+    // 选取有待处理帧、未被占用、优先级最高的一路, 无则返回-1
+    int pickStream()
+    {
+        int best = -1;
+        for (size_t i = 0; i < streams_.size(); i++)
+        {
+            Stream &stream = streams_[i];
+            if (stream.busy || !stream.receiver->hasPendingFrame())
+                continue;
+            if (best < 0 || stream.priority > streams_[best].priority ||
+                (stream.priority == streams_[best].priority && stream.last_serve < streams_[best].last_serve))
+            {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    void workerLoop()
+    {
+#ifdef _OPENMP
+        omp_set_num_threads(omp_threads_);
+#endif
+        std::unique_lock<std::mutex> guard(mutex_);
+        while (running_ && ros::ok())
+        {
+            int index = pickStream();
+            if (index < 0)
+            {
+                cond_.wait_for(guard, std::chrono::milliseconds(10));
+                continue;
+            }
+
+            Stream &stream = streams_[index];
+            stream.busy = true;
+            stream.last_serve = ++serve_count_;
+            guard.unlock();
+
+            stream.receiver->processPending();
+
+            guard.lock();
+            stream.busy = false;
+        }
+    }
+
+private:
+    const int spin_threads_;
+    const int worker_threads_;
+    const int omp_threads_;
+
+    ros::CallbackQueue callback_queue_;
+    std::unique_ptr<ros::AsyncSpinner> spinner_;
+
+    std::vector<Stream> streams_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_;
+    uint64_t serve_count_ = 0;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+
+#include <ros/ros.h>
+#include <tf/transform_datatypes.h>
+#include <tf2_ros/buffer.h>
+#include <tf2_ros/transform_listener.h>
+#include <geometry_msgs/TransformStamped.h>
+
+// 进程内共享的 tf2 缓存: 首次使用时创建并在独立线程中持续监听 /tf, /tf_static,
+// 之后的查询直接读缓存并按时间插值, 不再每次新建监听器并等待数秒
+class TfBufferService
+{
+public:
+    static std::shared_ptr<TfBufferService> instance()
+    {
+        static std::mutex mutex;
+        static std::shared_ptr<TfBufferService> service;
+        std::lock_guard<std::mutex> guard(mutex);
+        if (!service)
+        {
+            service.reset(new TfBufferService());
+            printf("[INFO] TfBufferService started.\n");
+        }
+        return service;
+    }
+
+    // 查询 stamp 时刻 source_frame 在 target_frame 下的位姿; stamp 为0时取最新值
+    // 缓存中尚无该时刻的数据时最多等待 timeout(数据已在缓存中时立即返回), 仍没有则退回最新值
+    bool lookup(const std::string &target_frame, const std::string &source_frame, const ros::Time &stamp,
+                tf::StampedTransform &transform, ros::Duration timeout = ros::Duration(0.5))
+    {
+        geometry_msgs::TransformStamped msg;
+        try
+        {
+            if (!stamp.isZero() && buffer_.canTransform(target_frame, source_frame, stamp, timeout))
+            {
+                msg = buffer_.lookupTransform(target_frame, source_frame, stamp);
+            }
+            else
+            {
+                if (!stamp.isZero())
+                {
+                    printf("[WARN] TfBufferService: %s -> %s not available at %.3f, using latest.\n",
+                           source_frame.c_str(), target_frame.c_str(), stamp.toSec());
+                }
+                msg = buffer_.lookupTransform(target_frame, source_frame, ros::Time(0), timeout);
+            }
+        }
+        catch (const tf2::TransformException &ex)
+        {
+            printf("[WARN] TfBufferService: %s\n", ex.what());
+            return false;
+        }
+        tf::transformStampedMsgToTF(msg, transform);
+        return true;
+    }
+
+    tf2_ros::Buffer &buffer() { return buffer_; }
+
+private:
+    TfBufferService() : buffer_(ros::Duration(30.0)), listener_(buffer_, true) {}
+
+    tf2_ros::Buffer buffer_;
+    tf2_ros::TransformListener listener_;
+};
@@ -13,6 +13,7 @@
 #include <mutex>
 #include <thread>
 #include <chrono>
+#include <memory>
 
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
@@ -38,6 +39,8 @@
 #include <message_filters/sync_policies/approximate_time.h>
 
 #include "camera_receiver.h"
+#include "depth_registration.h"
+#include "tf_buffer_service.h"
 
 class TuYangCameraReceiver : public CameraReceiver
 {
@@ -51,8 +54,6 @@ public:
 protected:
     virtual void createCloud(const cv::Mat &depth, const cv::Mat &color, pcl::PointCloud<pcl::PointXYZRGBA>::Ptr &cloud)
     {
-        // alignDepth2RGB(depth, depth_align_rgb_);
-        // std::cout << depth_align_rgb_.rows << "," << depth_align_rgb_.cols << endl;
         const float badPoint = std::numeric_limits<float>::quiet_NaN();
 
 #pragma omp parallel for
@@ -61,10 +62,10 @@ protected:
             pcl::PointXYZRGBA *itP = &cloud->points[r * depth.cols];
             const uint16_t *itD = depth.ptr<uint16_t>(r);
             const cv::Vec3b *itC = color.ptr<cv::Vec3b>(r);
-            const float y = getLookupY().at<float>(0, r);
-            const float *itX = getLookupX().ptr<float>();
+            const float *itX = lookupX.ptr<float>(r);
+            const float *itY = lookupY.ptr<float>(r);
 
-            for (size_t c = 0; c < (size_t)depth.cols; ++c, ++itP, ++itD, ++itC, ++itX)
+            for (size_t c = 0; c < (size_t)depth.cols; ++c, ++itP, ++itD, ++itC, ++itX, ++itY)
             {
                 register const float depthValue = *itD / 1000.0f;
                 // std::cout << depthValue << endl;
@@ -78,7 +79,7 @@ protected:
                 }
                 itP->z = depthValue;
                 itP->x = *itX * depthValue;
-                itP->y = y * depthValue;
+                itP->y = *itY * depthValue;
                 // itP->b = 255;
                 // itP->g = 255;
                 // itP->r = 255;
@@ -90,128 +91,139 @@ protected:
             }
         }
     }
+    // 主机端配准: 订阅原始深度图(如 /camera/depth/image_raw), 由接收器配准到彩色图像, 不再依赖驱动的 image_align
+    cv::Mat alignDepth(const cv::Mat &depth) override
+    {
+        if (!hostAlign_)
+        {
+            return depth;
+        }
+        cv::Mat aligned;
+        alignDepth2RGB(depth, aligned);
+
+        lock.lock();
+        depth_align_rgb_ = aligned;
+        lock.unlock();
+        return aligned;
+    }
+
+public:
+    // 需在run()之前调用; holeFill: 填补配准后的单像素空洞
+    void setHostAlign(bool enable, bool holeFill = true)
+    {
+        hostAlign_ = enable;
+        registration_.setHoleFill(holeFill);
+    }
+
+    // 指定外参查询所用的tf缓存, 默认使用进程内共享的缓存
+    void setTfBuffer(std::shared_ptr<TfBufferService> tf_buffer) { tf_buffer_ = std::move(tf_buffer); }
+
     cv::Mat getDepth2RGB()
     {
+        std::lock_guard<std::mutex> guard(lock);
         return depth_align_rgb_;
     }
 
 private:
     void alignDepth2RGB(const cv::Mat &src, cv::Mat &dst);
-    void tfTrans(std::string source_frame, std::string target_grame, tf::StampedTransform &transform);
-    void depth2RGB(const cv::Mat &src, cv::Mat &dst, const float *W);
+    bool updateRegistration(const cv::Size &sizeDepth);
+    bool tfTrans(std::string source_frame, std::string target_grame, tf::StampedTransform &transform, ros::Duration timeout);
 
-    void StampedTfToArray(const tf::StampedTransform &transform, float *W);
+    static constexpr double kExtrinsicCheckPeriod = 5.0; // 外参复查周期(秒), 复查只读取已缓存的TF
 
     cv::Mat depth_align_rgb_;
+    bool hostAlign_ = false;
+    DepthRegistration registration_;
+
+    // 配准缓存: 记录生成当前系数表时的内参版本与外参
+    std::shared_ptr<TfBufferService> tf_buffer_;
+    uint64_t registrationInfoVersion_ = 0;
+    tf::Transform extrinsic_;
+    ros::WallTime lastExtrinsicCheck_;
 };
 
-void TuYangCameraReceiver::alignDepth2RGB(const cv::Mat &src, cv::Mat &dst)
+inline void TuYangCameraReceiver::alignDepth2RGB(const cv::Mat &src, cv::Mat &dst)
 {
-    tf::Matrix3x3 roat;
-    tf::Quaternion quat;
-
-    // 深度坐标系转彩色坐标系
-    tf::StampedTransform transform_m;
-    tfTrans("camera_rgb_optical_frame", "camera_depth_optical_frame", transform_m);
-    transform_m.setOrigin(tf::Vector3(50, 0, 0));
-
-    // rgb内参
-    tf::StampedTransform transform_krgb;
-    roat.setValue(cameraMatrixColor.at<double>(0, 0), cameraMatrixColor.at<double>(0, 1), cameraMatrixColor.at<double>(0, 2),
-                  cameraMatrixColor.at<double>(1, 0), cameraMatrixColor.at<double>(1, 1), cameraMatrixColor.at<double>(1, 2),
-                  cameraMatrixColor.at<double>(2, 0), cameraMatrixColor.at<double>(2, 1), cameraMatrixColor.at<double>(2, 2));
-    roat.getRotation(quat);
-    transform_krgb.setOrigin(tf::Vector3(0, 0, 0));
-    transform_krgb.setRotation(quat);
-    std::cout << cameraMatrixColor.at<double>(0, 0) << " " << cameraMatrixColor.at<double>(0, 1) << " " << cameraMatrixColor.at<double>(0, 2) << endl;
-    std::cout << cameraMatrixColor.at<double>(1, 0) << " " << cameraMatrixColor.at<double>(1, 1) << " " << cameraMatrixColor.at<double>(1, 2) << endl;
-    std::cout << cameraMatrixColor.at<double>(2, 0) << " " << cameraMatrixColor.at<double>(2, 1) << " " << cameraMatrixColor.at<double>(2, 2) << endl;
-
-    // depth内参
-    tf::StampedTransform transform_kdepth;
-    roat.setValue(cameraMatrixDepth.at<double>(0, 0), cameraMatrixDepth.at<double>(0, 1), cameraMatrixDepth.at<double>(0, 2),
-                  cameraMatrixDepth.at<double>(1, 0), cameraMatrixDepth.at<double>(1, 1), cameraMatrixDepth.at<double>(1, 2),
-                  cameraMatrixDepth.at<double>(2, 0), cameraMatrixDepth.at<double>(2, 1), cameraMatrixDepth.at<double>(2, 2));
-    roat.getRotation(quat);
-    transform_kdepth.setOrigin(tf::Vector3(0, 0, 0));
-    transform_kdepth.setRotation(quat);
-    std::cout << cameraMatrixDepth.at<double>(0, 0) << " " << cameraMatrixDepth.at<double>(0, 1) << " " << cameraMatrixDepth.at<double>(0, 2) << endl;
-    std::cout << cameraMatrixDepth.at<double>(1, 0) << " " << cameraMatrixDepth.at<double>(1, 1) << " " << cameraMatrixDepth.at<double>(1, 2) << endl;
-    std::cout << cameraMatrixDepth.at<double>(2, 0) << " " << cameraMatrixDepth.at<double>(2, 1) << " " << cameraMatrixDepth.at<double>(2, 2) << endl;
-
-    tf::StampedTransform transform_tmp1, transform_tmp2;
-    transform_tmp1.mult(transform_m, transform_kdepth.inverse());
-    transform_tmp2.mult(transform_krgb, transform_tmp1);
-    // transform_krgb *transform_m *transform_kdepth.inverse();
-
-    std::cout
-        << "transform" << transform_tmp2.getOrigin().getX() << endl;
-    float W[4 * 4];
-    StampedTfToArray(transform_tmp2, W);
-    std::cout << W[0 * 4 + 0] << " " << W[0 * 4 + 1] << " " << W[0 * 4 + 2] << " " << W[0 * 4 + 3] << " " << endl;
-    std::cout << W[1 * 4 + 0] << " " << W[1 * 4 + 1] << " " << W[1 * 4 + 2] << " " << W[1 * 4 + 3] << " " << endl;
-    std::cout << W[2 * 4 + 0] << " " << W[2 * 4 + 1] << " " << W[2 * 4 + 2] << " " << W[2 * 4 + 3] << " " << endl;
-    std::cout << W[3 * 4 + 0] << " " << W[3 * 4 + 1] << " " << W[3 * 4 + 2] << " " << W[3 * 4 + 3] << " " << endl;
-
-    depth2RGB(src, dst, W);
+    if (!updateRegistration(src.size()))
+    {
+        // 尚未取得外参, 输出全部无效的深度图
+        lock.lock();
+        dst = cv::Mat::zeros(cameraInfoColor.height, cameraInfoColor.width, CV_16UC1);
+        lock.unlock();
+        return;
+    }
+    registration_.registerDepth(src, dst);
 }
 
-void TuYangCameraReceiver::tfTrans(std::string source_frame, std::string target_grame, tf::StampedTransform &transform)
+// 仅在内参版本、深度图尺寸或外参变化时重建配准系数表, 其余帧直接返回
+inline bool TuYangCameraReceiver::updateRegistration(const cv::Size &sizeDepth)
 {
-    tf::TransformListener listener;
+    const uint64_t infoVersion = cameraInfoVersion;
+    const ros::WallTime now = ros::WallTime::now();
+    const bool infoChanged = infoVersion != registrationInfoVersion_ ||
+                             (registration_.isInitialized() && registration_.depthSize() != sizeDepth);
+    if (registration_.isInitialized() && !infoChanged && (now - lastExtrinsicCheck_).toSec() < kExtrinsicCheckPeriod)
+    {
+        return true;
+    }
+    lastExtrinsicCheck_ = now;
+
+    cv::Mat cameraMatrixD, distCoeffsD, cameraMatrixC;
+    std::string frameDepth, frameColor;
+    cv::Size sizeColor;
+    lock.lock();
+    cameraMatrixDepth.copyTo(cameraMatrixD);
+    distCoeffsDepth.copyTo(distCoeffsD);
+    cameraMatrixColor.copyTo(cameraMatrixC);
+    frameDepth = cameraInfoDepth.header.frame_id.empty() ? "camera_depth_optical_frame" : cameraInfoDepth.header.frame_id;
+    frameColor = cameraInfoColor.header.frame_id.empty() ? "camera_rgb_optical_frame" : cameraInfoColor.header.frame_id;
+    sizeColor = cv::Size(cameraInfoColor.width, cameraInfoColor.height);
+    lock.unlock();
+
+    // 深度坐标系到彩色坐标系, 首次获取时等待, 之后只读缓存;
+    // 已初始化后查询失败时沿用上次的外参, 内参或尺寸变化时仍须以其重建, 旧系数表不再适用
+    tf::StampedTransform transform;
+    const ros::Duration timeout = registration_.isInitialized() ? ros::Duration(0) : ros::Duration(3);
+    if (!tfTrans(frameDepth, frameColor, transform, timeout))
+    {
+        if (!registration_.isInitialized())
+        {
+            return false;
+        }
+        if (!infoChanged)
+        {
+            return true;
+        }
+        transform.setData(extrinsic_);
+    }
 
-    listener.waitForTransform(target_grame, source_frame, ros::Time(0), ros::Duration(3));
-    listener.lookupTransform(target_grame, source_frame, ros::Time(0), transform);
-}
+    const bool extrinsicChanged = !registration_.isInitialized() ||
+                                  !(transform.getOrigin() == extrinsic_.getOrigin()) ||
+                                  !(transform.getBasis() == extrinsic_.getBasis());
+    if (!infoChanged && !extrinsicChanged)
+    {
+        return true;
+    }
 
-void TuYangCameraReceiver::StampedTfToArray(const tf::StampedTransform &transform, float *W)
-{
-    tf::Matrix3x3 roat(transform.getRotation());
-    W[0 * 4 + 0] = roat.getRow(0).getX();
-    W[0 * 4 + 1] = roat.getRow(0).getY();
-    W[0 * 4 + 2] = roat.getRow(0).getZ();
-    W[0 * 4 + 3] = transform.getOrigin().getX();
-
-    W[1 * 4 + 0] = roat.getRow(1).getX();
-    W[1 * 4 + 1] = roat.getRow(1).getY();
-    W[1 * 4 + 2] = roat.getRow(1).getZ();
-    W[1 * 4 + 3] = transform.getOrigin().getY();
-
-    W[2 * 4 + 0] = roat.getRow(2).getX();
-    W[2 * 4 + 1] = roat.getRow(2).getY();
-    W[2 * 4 + 2] = roat.getRow(2).getZ();
-    W[2 * 4 + 3] = transform.getOrigin().getZ();
-
-    W[3 * 4 + 0] = 0;
-    W[3 * 4 + 1] = 0;
-    W[3 * 4 + 2] = 0;
-    W[3 * 4 + 3] = 1;
+    const tf::Matrix3x3 basis = transform.getBasis();
+    const tf::Vector3 origin = transform.getOrigin();
+    const cv::Matx33d rotation(basis[0][0], basis[0][1], basis[0][2],
+                               basis[1][0], basis[1][1], basis[1][2],
+                               basis[2][0], basis[2][1], basis[2][2]);
+    const cv::Vec3d translation(origin.x(), origin.y(), origin.z());
+
+    registration_.init(cameraMatrixD, distCoeffsD, sizeDepth, cameraMatrixC, sizeColor, rotation, translation);
+    registrationInfoVersion_ = infoVersion;
+    extrinsic_ = transform;
+    return true;
 }
 
-void TuYangCameraReceiver::depth2RGB(const cv::Mat &src, cv::Mat &dst, const float *W)
+inline bool TuYangCameraReceiver::tfTrans(std::string source_frame, std::string target_grame, tf::StampedTransform &transform, ros::Duration timeout)
 {
-    double z;
-    uint16_t u, v, d;
-    uint16_t u_rgb, v_rgb;
-    cv::Mat newdepth(src.rows, src.cols, CV_16UC1, cv::Scalar(0));
-    for (v = 0; v < src.rows; v++)
+    // 外参为静态变换, 取缓存中的最新值
+    if (!tf_buffer_)
     {
-        for (u = 0; u < src.cols; u++)
-        {
-            d = src.at<uint16_t>(v, u);
-            z = (double)d / 4000;
-            u_rgb = (uint16_t)((W[0] * (double)u + W[1] * (double)v + W[2] + W[3] / z)); //参照上述公式（5）
-            v_rgb = (uint16_t)((W[4] * (double)u + W[5] * (double)v + W[6] + W[7] / z)); //参照上述公式（6）
-            // double z_rgb = (double)((W[3 * 4 + 0] * (double)u + W[3 * 4 + 1] * (double)v + W[3 * 4 + 2] + W[3 * 4 + 0] / z));
-            // std::cout << u_rgb << "," << v_rgb << "std::endl";
-            // if (u_rgb < 0 && u_rgb >= newdepth.cols && v_rgb < 0 && v_rgb >= newdepth.rows)
-            if (u_rgb >= 0 && u_rgb < newdepth.cols && v_rgb >= 0 && v_rgb < newdepth.rows)
-            {
-                uint16_t *val = (uint16_t *)newdepth.ptr<uint16_t>(v_rgb) + u_rgb;
-                *val = d;
-                // std::cout << u_rgb << "," << v_rgb << std::endl;
-            }
-        }
+        tf_buffer_ = TfBufferService::instance();
     }
-    dst = newdepth;
-}
\ No newline at end of file
+    return tf_buffer_->lookup(target_grame, source_frame, ros::Time(0), transform, timeout);
+}
@@ -3,6 +3,8 @@
 #include <vector>
 #include <string>
 
+#include "fusion/tsdf_volume.h"
+
 class Fusion
 {
 private:
@@ -11,5 +13,9 @@ public:
     Fusion(/* args */) = default;
     virtual ~Fusion() = default;
 
+    // save_ply_path 为空时不导出 ply
     virtual void fusion(std::string img_folder, int num, const float *target_pos, std::string save_ply_path) = 0;
+
+    // 上一次融合得到的体素, 不保留体素的实现返回 nullptr
+    virtual const TsdfVolume *getVolume() const { return nullptr; }
 };
@@ -4,4 +4,8 @@
 #include <string>
 #include <iostream>
 
-extern "C" void TSDF_Fusion(const char *data_folder, int frame_nums, const float *target_pos, const char *save_path);
\ No newline at end of file
+struct TsdfVolume;
+
+// volume 非空时保留融合后的体素; save_path 为空时不导出 ply
+extern "C" void TSDF_Fusion(const char *data_folder, int frame_nums, const float *target_pos, const char *save_path,
+                            TsdfVolume *volume);
\ No newline at end of file
@@ -14,6 +14,12 @@ public:
 
     void fusion(std::string img_folder, int num, const float *target_pos, std::string save_ply_path);
 
+    const TsdfVolume *getVolume() const
+    {
+        return volume_.empty() ? nullptr : &volume_;
+    }
+
 private:
     /* data */
+    TsdfVolume volume_; // 融合结果, 多次融合间复用内存
 };
\ No newline at end of file
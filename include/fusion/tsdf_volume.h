@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+// 融合完成后拷回主机的 TSDF 体素, 供检测直接查询, 不再导出点云
+// 体素 (x, y, z) 的中心在 base 相机坐标系下为 origin + (x, y, z) * voxel_size
+// tsdf 按截断距离归一化到 [-1, 1], 表面前方(相机一侧)为正; weight 为 0 表示未观测
+struct TsdfVolume
+{
+    int dim_x = 0;
+    int dim_y = 0;
+    int dim_z = 0;
+    float voxel_size = 0;
+    float trunc_margin = 0;
+    float origin[3] = {0, 0, 0};
+    float base2world[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}; // 行优先
+
+    std::vector<float> tsdf;
+    std::vector<float> weight;
+
+    bool empty() const { return tsdf.empty(); }
+
+    int index(int x, int y, int z) const { return (z * dim_y + y) * dim_x + x; }
+
+    // 三线性插值, 返回以米为单位的有符号距离; 超出体素范围或任一角点未观测时返回 false
+    bool sample(float px, float py, float pz, float &sdf) const
+    {
+        const float gx = (px - origin[0]) / voxel_size;
+        const float gy = (py - origin[1]) / voxel_size;
+        const float gz = (pz - origin[2]) / voxel_size;
+        const int x0 = (int)std::floor(gx), y0 = (int)std::floor(gy), z0 = (int)std::floor(gz);
+        if (x0 < 0 || y0 < 0 || z0 < 0 || x0 + 1 >= dim_x || y0 + 1 >= dim_y || z0 + 1 >= dim_z)
+        {
+            return false;
+        }
+
+        const float fx = gx - x0, fy = gy - y0, fz = gz - z0;
+        const int sx = 1, sy = dim_x, sz = dim_x * dim_y;
+        const int i = index(x0, y0, z0);
+        const int corner[8] = {i, i + sx, i + sy, i + sx + sy, i + sz, i + sx + sz, i + sy + sz, i + sx + sy + sz};
+        for (int k = 0; k < 8; k++)
+        {
+            if (weight[corner[k]] <= 0)
+            {
+                return false;
+            }
+        }
+
+        const float c00 = tsdf[corner[0]] + fx * (tsdf[corner[1]] - tsdf[corner[0]]);
+        const float c10 = tsdf[corner[2]] + fx * (tsdf[corner[3]] - tsdf[corner[2]]);
+        const float c01 = tsdf[corner[4]] + fx * (tsdf[corner[5]] - tsdf[corner[4]]);
+        const float c11 = tsdf[corner[6]] + fx * (tsdf[corner[7]] - tsdf[corner[6]]);
+        const float c0 = c00 + fy * (c10 - c00);
+        const float c1 = c01 + fy * (c11 - c01);
+        sdf = (c0 + fz * (c1 - c0)) * trunc_margin;
+        return true;
+    }
+};
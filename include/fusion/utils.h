@@ -11,7 +11,7 @@ void transform_point(const float *trans, const float *tmp_pt, float *out_pt);
 // Compute surface points from TSDF voxel grid and save points to point cloud file
 void SaveVoxelGrid2SurfacePointCloud(const std::string &file_name, int voxel_grid_dim_x, int voxel_grid_dim_y, int voxel_grid_dim_z,
                                      float voxel_size, float voxel_grid_origin_x, float voxel_grid_origin_y, float voxel_grid_origin_z,
-                                     float *voxel_grid_TSDF, float *voxel_grid_weight,
+                                     const float *voxel_grid_TSDF, const float *voxel_grid_weight,
                                      float tsdf_thresh, float weight_thresh, const float cam2world[16]);
 
 // Load an M x N matrix from a text file (numbers delimited by spaces/tabs)
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+
+// 平面内的圆拟合, 替代 SACSegmentation(SACMODEL_CIRCLE3D):
+// 已知平面法向时, 将点投影到平面的二维坐标系, 三点外接圆作为假设, 对当前最优假设的局内点
+// 用 Taubin 代数拟合做几次局部优化(LO-RANSAC); 有半径先验时丢弃半径超出范围的假设
+// 圆心高度取局内点到平面有符号距离的中值, 即拟合以平面法向为轴的圆柱截面
+class CircleFit2D
+{
+public:
+    struct Params
+    {
+        float distance_threshold = 0.003f; // 局内点到圆周的最大距离(米, 平面内)
+        float min_radius = 0;              // 半径先验, max_radius<=0 时不限制
+        float max_radius = 0;
+        int max_iterations = 200;          // 迭代次数上限, 按局内点比例自适应提前终止
+        int lo_iterations = 3;             // 每次得到更优假设后的局部优化次数
+        float probability = 0.99f;
+        uint32_t seed = 12345;
+    };
+
+    // 拟合质量, 由最终局内点的残差闭式估计(高斯-牛顿近似), 不额外遍历点云
+    struct Quality
+    {
+        int inliers = 0;
+        float rms = 0;                                               // 局内点到圆周距离的均方根(米)
+        Eigen::Matrix3d center_covariance = Eigen::Matrix3d::Zero(); // 圆心的协方差, 与输入点云同一坐标系
+        double radius_variance = 0;
+    };
+
+    CircleFit2D() : CircleFit2D(Params()) {}
+    explicit CircleFit2D(const Params &params) : params_(params) {}
+
+    // plane: 平面方程 ax+by+cz+d=0, (a, b, c) 无需归一化; indices 为空时使用全部点
+    template <typename PointT>
+    void setInputCloud(const pcl::PointCloud<PointT> &cloud, const Eigen::Vector4f &plane,
+                       const std::vector<int> &indices = std::vector<int>());
+
+    // coefficients 与 SACMODEL_CIRCLE3D 一致: (cx, cy, cz, r, nx, ny, nz); inliers 为输入点云中的下标
+    bool fit(pcl::PointIndices &inliers, pcl::ModelCoefficients &coefficients);
+
+    // 代数拟合, 点数不少于3; 成功时返回 true 并写入圆心与半径
+    static bool fitKasa(const float *u, const float *v, int n, float &cu, float &cv, float &r);
+    static bool fitTaubin(const float *u, const float *v, int n, float &cu, float &cv, float &r);
+
+    int iterations() const { return iterations_; }
+
+    // 上一次 fit() 成功时的拟合质量
+    const Quality &quality() const { return quality_; }
+
+    Params &params() { return params_; }
+
+private:
+    void addPoint(float x, float y, float z, int index);
+
+    int countInliers(float cu, float cv, float r) const;
+
+    // 局内点收集到 lo_u_/lo_v_ 后做 Taubin 拟合
+    bool refine(float &cu, float &cv, float &r);
+
+    bool radiusValid(float r) const
+    {
+        return params_.max_radius <= 0 || (r >= params_.min_radius && r <= params_.max_radius);
+    }
+
+private:
+    Params params_;
+    int iterations_ = 0;
+    Quality quality_;
+
+    Eigen::Vector3f normal_, origin_, e1_, e2_; // 平面法向, 平面上一点, 平面内两个正交方向
+    std::vector<float> u_, v_, h_;              // 平面坐标与到平面的有符号距离
+    std::vector<int> index_;
+    std::vector<float> lo_u_, lo_v_;
+    std::vector<float> heights_; // 局内点高度, 取中值
+};
+
+template <typename PointT>
+void CircleFit2D::setInputCloud(const pcl::PointCloud<PointT> &cloud, const Eigen::Vector4f &plane,
+                                const std::vector<int> &indices)
+{
+    const float norm = plane.head<3>().norm();
+    normal_ = plane.head<3>() / norm;
+    origin_ = -plane[3] / norm * normal_;
+
+    // 平面内的正交基
+    const Eigen::Vector3f ref = std::abs(normal_[0]) < 0.9f ? Eigen::Vector3f::UnitX() : Eigen::Vector3f::UnitY();
+    e1_ = normal_.cross(ref).normalized();
+    e2_ = normal_.cross(e1_);
+
+    u_.clear();
+    v_.clear();
+    h_.clear();
+    index_.clear();
+    if (indices.empty())
+    {
+        for (int i = 0; i < (int)cloud.size(); i++)
+        {
+            addPoint(cloud.points[i].x, cloud.points[i].y, cloud.points[i].z, i);
+        }
+    }
+    else
+    {
+        for (const int i : indices)
+        {
+            addPoint(cloud.points[i].x, cloud.points[i].y, cloud.points[i].z, i);
+        }
+    }
+}
+
+inline void CircleFit2D::addPoint(float x, float y, float z, int index)
+{
+    if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z))
+    {
+        return;
+    }
+    const Eigen::Vector3f p = Eigen::Vector3f(x, y, z) - origin_;
+    u_.push_back(p.dot(e1_));
+    v_.push_back(p.dot(e2_));
+    h_.push_back(p.dot(normal_));
+    index_.push_back(index);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "oil_detect/circle_voter.h"
+
+// 加油口圆检测结果, 坐标为当前输入图像的像素坐标
+struct CircleDetection
+{
+    cv::Point2f center;
+    float radius = 0;
+    float confidence = 0; // 圆周上梯度沿径向的边缘点比例, [0, 1]
+    float score = 0;      // 综合得分(尺寸先验, 边缘深度跳变, 边缘支持), 无深度先验时等于 confidence
+    bool tracked = false; // true: 来自跟踪窗口, false: 来自整帧搜索
+};
+
+// 加油口圆跟踪: 上一帧检测可信时只在其周围的窗口内、以上一帧半径±容差搜索,
+// 窗口内未检到或置信度不足时退回整帧霍夫检测
+class CircleTracker
+{
+public:
+    struct Params
+    {
+        bool enable = true;             // false 时每帧都整帧搜索
+        int min_radius = 40;            // 整帧搜索的半径范围(原始分辨率像素)
+        int max_radius = 200;
+        int blur_size = 10;             // 均值滤波核(原始分辨率像素)
+        bool half_resolution = false;   // 整帧搜索在灰度图的1/2分辨率上进行, 跟踪窗口仍用当前层分辨率
+        double canny_threshold = 80;    // canny上限, 下限自动设置为上限一半
+        double acc_threshold = 30;      // 霍夫累加阈值, 越大越圆
+        float radius_tolerance = 0.15f; // 跟踪时半径允许的相对变化
+        float window_margin = 0.6f;     // 跟踪窗口在半径之外的扩展(半径的倍数)
+        float min_confidence = 0.4f;    // 低于该置信度视为丢失, 下一帧整帧搜索
+
+        // 深度先验: 由场景深度中值与焦距预测加油口的像素半径, 只搜索预测值附近的半径
+        float physical_radius = 0.0415f; // 加油口实际半径(米), 与精检测的 0.040~0.043 一致
+        float prior_tolerance = 0.25f;   // 预测半径允许的相对误差
+        float depth_scale = 1000.0f;     // 深度值每米对应的单位数
+        float min_rim_step = 0.004f;     // 圆周内外深度差超过该值(米)视为边缘跳变
+        int max_candidates = 10;         // 参与评分的候选圆个数
+    };
+
+    CircleTracker() : CircleTracker(Params()) {}
+    explicit CircleTracker(const Params &params) : params_(params), has_track_(false) {}
+
+    // color: 当前层的彩色图像; scale: 当前层相对原始分辨率的缩放倍数(1, 2, 4)
+    bool detect(const cv::Mat &color, int scale, CircleDetection &result);
+
+    // 设置本帧的深度先验, 需在 detect() 前调用; depth: 与 color 同尺寸的 CV_16UC1 深度图, fx: 该尺寸下的焦距(像素)
+    // depth 为空或 fx<=0 时不使用先验
+    void setDepthPrior(const cv::Mat &depth, float fx)
+    {
+        depth_ = depth;
+        fx_ = fx;
+    }
+
+    // 由归一化射线表估计图像中心处的焦距
+    static float focalFromLookup(const cv::Mat &lookup_x);
+
+    // 按得分从高到低给出至多 k 个候选圆, 跟踪窗口内的结果排在最前; 不更新跟踪状态
+    bool detectCandidates(const cv::Mat &color, int scale, int k, std::vector<CircleDetection> &candidates);
+
+    // 以外部验证后的结果作为跟踪起点
+    void accept(const CircleDetection &result, int scale)
+    {
+        has_track_ = result.confidence >= params_.min_confidence;
+        last_center_ = result.center * (float)scale;
+        last_radius_ = result.radius * scale;
+    }
+
+    void reset() { has_track_ = false; }
+
+    bool isTracking() const { return has_track_; }
+
+    Params &params() { return params_; }
+
+private:
+    bool detectInWindow(const cv::Mat &color, int scale, CircleDetection &result);
+    bool detectFullFrame(const cv::Mat &color, int scale, CircleDetection &result);
+    bool detectWithPrior(std::vector<CircleDetection> &candidates);
+
+    // 计算候选圆的置信度与得分并按得分排序, r_pred>0 时计入尺寸先验与深度跳变, 相互重叠的候选只保留得分高的
+    // circles 为整帧灰度图 gray_ 上的坐标, 结果换算回当前层坐标
+    void scoreCandidates(const std::vector<cv::Vec3f> &circles, float r_pred, std::vector<CircleDetection> &candidates);
+
+    // 先转灰度, 再(可选)降采样与单通道均值滤波, 结果写入 out_buf 的子矩阵; 尺寸不变时不再分配内存
+    // factor: 结果相对输入的缩放倍数
+    cv::Mat preprocess(const cv::Mat &color, int scale, bool half, cv::Mat &gray_buf, cv::Mat &out_buf, int &factor);
+
+    // 在整帧灰度图上投票, 半径与间距为当前层像素
+    void voteFullFrame(int min_r, int max_r, float min_dist);
+
+    // 沿圆周采样, 统计梯度幅值足够且方向接近径向的比例
+    static float edgeSupport(const cv::Mat &gray, const cv::Point2f &center, float radius);
+
+    // 深度图的中值(米), 隔点采样, 无有效深度时返回0
+    float medianDepth(const cv::Mat &depth);
+
+    // 圆周内外深度存在跳变的采样比例
+    float rimDiscontinuity(const cv::Point2f &center, float radius) const;
+
+private:
+    Params params_;
+
+    bool has_track_;
+    cv::Point2f last_center_; // 上一帧结果, 原始分辨率像素坐标
+    float last_radius_;
+
+    CircleVoter voter_;
+
+    cv::Mat gray_;    // 整帧搜索的滤波灰度图(下列缓存的子矩阵)
+    int factor_ = 1;  // gray_ 相对当前层的缩放倍数
+    cv::Mat gray_buf_, half_buf_, blur_buf_;
+    cv::Mat win_gray_buf_, win_blur_buf_;
+    std::vector<cv::Vec3f> circles_;
+    std::vector<CircleDetection> scored_, prior_candidates_;
+
+    cv::Mat depth_; // 本帧深度先验
+    float fx_ = 0;
+    std::vector<uint16_t> depth_samples_;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+// 基于梯度的圆检测投票器, 与 cv::HOUGH_GRADIENT 原理相同:
+// Sobel 梯度 -> Canny 边缘 -> 边缘点沿梯度方向对圆心投票 -> 圆心处按边缘点距离直方图估计半径
+// 所有中间结果使用成员缓存, 图像尺寸不变时每帧不再分配内存
+class CircleVoter
+{
+public:
+    struct Params
+    {
+        double canny_threshold = 80; // canny上限, 下限为上限一半
+        int acc_threshold = 30;      // 圆心票数与半径支持点数的最小值
+        int max_centers = 64;        // 参与半径估计的圆心个数上限
+    };
+
+    CircleVoter() : CircleVoter(Params()) {}
+    explicit CircleVoter(const Params &params) : params_(params) {}
+
+    // gray: 已滤波的单通道图像; 结果 (x, y, r) 按圆心票数从高到低排列, 圆心间距不小于 min_dist
+    void detect(const cv::Mat &gray, int min_radius, int max_radius, float min_dist, std::vector<cv::Vec3f> &circles);
+
+    Params &params() { return params_; }
+
+    // 返回缓存左上角 size 大小的子矩阵, 缓存不够大时才重新分配;
+    // 以其为输入做邻域滤波时须加 BORDER_ISOLATED, 否则边界会读到子矩阵外之前帧留下的像素
+    static cv::Mat reuseBuffer(cv::Mat &buffer, const cv::Size &size, int type);
+
+private:
+    void vote(const cv::Mat &dx, const cv::Mat &dy, const cv::Mat &edges, int min_radius, int max_radius);
+    void findCenters(const cv::Size &size);
+    int estimateRadius(const cv::Point &center, int min_radius, int max_radius);
+
+private:
+    Params params_;
+
+    cv::Mat dx_, dy_;   // Sobel 梯度, CV_16S
+    cv::Mat edges_;     // Canny 边缘
+    cv::Mat accum_;     // 圆心累加器, 四周各留一个像素
+    std::vector<cv::Point> edge_points_;
+    std::vector<std::pair<int, int>> centers_; // (票数, 累加器索引)
+    std::vector<int> radius_hist_;
+};
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include <Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/PointIndices.h>
+#include <pcl/ModelCoefficients.h>
+
+#include "oil_detect/plane_ransac.h"
+#include "oil_detect/circle_fit_2d.h"
+
+// 检测器每帧用到的中间缓存与拟合器, 作为检测器成员在多帧间复用:
+// 容量只增不减, 按 ROI 尺寸预留后稳定状态下每帧不再分配堆内存
+struct DetectorWorkspace
+{
+    static const size_t kParallelBandArea = 128 * 128; // extractBand 的 ROI 小于该像素数时单线程
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud; // ROI 点云
+    pcl::PointIndices::Ptr inliers;
+    pcl::PointIndices::Ptr outliers;
+    pcl::ModelCoefficients::Ptr plane;  // 平面系数 (a, b, c, d)
+    pcl::ModelCoefficients::Ptr circle; // 圆系数 (cx, cy, cz, r, nx, ny, nz)
+    std::vector<float> depths;
+
+    // extractBand 的逐行统计与有效点缓存(只增不减, 避免每帧重新构造点)
+    std::vector<float> row_min;
+    std::vector<int> row_count;
+    std::vector<pcl::PointXYZ, Eigen::aligned_allocator<pcl::PointXYZ>> band_buffer;
+
+    PlaneRansac plane_ransac;
+    CircleFit2D circle_fit;
+
+    DetectorWorkspace()
+        : cloud(new pcl::PointCloud<pcl::PointXYZ>), inliers(new pcl::PointIndices), outliers(new pcl::PointIndices),
+          plane(new pcl::ModelCoefficients), circle(new pcl::ModelCoefficients)
+    {
+        plane->values.reserve(4);
+        circle->values.reserve(7);
+    }
+
+    // 按 ROI 内的点数预留容量
+    void reserve(size_t points)
+    {
+        cloud->points.reserve(points);
+        inliers->indices.reserve(points);
+        outliers->indices.reserve(points);
+        depths.reserve(points);
+    }
+
+    // extractBand 的结果: ROI 内的有效点数(深度有限且为正)与最小深度, 无有效点时 min_depth 为 NaN
+    struct BandStats
+    {
+        int valid = 0;
+        float min_depth = std::numeric_limits<float>::quiet_NaN();
+    };
+
+    // 从有组织点云的 ROI 中取出深度在 (0, 最小深度 + band) 内的点, 顺序与逐点遍历 ROI 相同, 结果与线程数无关:
+    // 第一阶段逐行并行, 只读一遍 ROI, 有效点写入缓存中该行的段并求行内最小深度与点数;
+    // 第二阶段由全局最小深度逐行并行就地筛选, 再按行顺序写入 out. 缓存按 ROI 增长后多帧复用; ROI 较小时不开线程
+    template <typename PointT>
+    BandStats extractBand(const pcl::PointCloud<PointT> &input, int x, int y, int width, int height, double band,
+                          pcl::PointCloud<pcl::PointXYZ> &out)
+    {
+        BandStats stats;
+        out.width = 0;
+        out.height = 1;
+        if (width <= 0 || height <= 0)
+        {
+            out.points.clear();
+            return stats;
+        }
+        const size_t area = (size_t)width * height;
+        const bool parallel = area >= kParallelBandArea;
+        if (band_buffer.size() < area)
+        {
+            band_buffer.resize(area);
+        }
+        row_min.resize(height);
+        row_count.resize(height);
+        pcl::PointXYZ *buffer = band_buffer.data();
+
+        // 第一阶段: 有效点与行内最小深度
+        int valid = 0;
+#pragma omp parallel for schedule(static) reduction(+ : valid) if (parallel)
+        for (int r = 0; r < height; r++)
+        {
+            const PointT *src = &input.points[(size_t)(y + r) * input.width + x];
+            pcl::PointXYZ *dst = buffer + (size_t)r * width;
+            float min_z = std::numeric_limits<float>::infinity();
+            int count = 0;
+            for (int c = 0; c < width; c++)
+            {
+                // 有效点(NaN 比较为假)才写入并参与最小值; 此处分支版本实测快于无分支写入
+                const float z = src[c].z;
+                if (z > 0 && z < std::numeric_limits<float>::infinity())
+                {
+                    dst[count].x = src[c].x;
+                    dst[count].y = src[c].y;
+                    dst[count].z = z;
+                    ++count;
+                    min_z = std::min(min_z, z);
+                }
+            }
+            row_min[r] = min_z;
+            row_count[r] = count;
+            valid += count;
+        }
+        stats.valid = valid;
+        if (valid == 0)
+        {
+            out.points.clear();
+            return stats;
+        }
+        stats.min_depth = *std::min_element(row_min.begin(), row_min.end());
+
+        // 第二阶段: 行内就地筛选, 再把各行依次前移
+        const double limit = stats.min_depth + band;
+#pragma omp parallel for schedule(static) if (parallel)
+        for (int r = 0; r < height; r++)
+        {
+            pcl::PointXYZ *row = buffer + (size_t)r * width;
+            int kept = 0;
+            for (int k = 0; k < row_count[r]; k++)
+            {
+                row[kept] = row[k];
+                kept += row[k].z < limit;
+            }
+            row_count[r] = kept;
+        }
+        size_t total = 0;
+        for (int r = 0; r < height; r++)
+        {
+            total += row_count[r];
+        }
+        out.points.resize(total);
+        pcl::PointXYZ *dst = out.points.data();
+        for (int r = 0; r < height; r++)
+        {
+            const pcl::PointXYZ *row = buffer + (size_t)r * width;
+            dst = std::copy(row, row + row_count[r], dst);
+        }
+        out.width = (uint32_t)total;
+        return stats;
+    }
+
+    // outliers = [0, n) 中不在 inliers 里的下标, inliers 需升序
+    void complementInliers(int n)
+    {
+        outliers->indices.clear();
+        auto it = inliers->indices.begin();
+        for (int i = 0; i < n; i++)
+        {
+            if (it != inliers->indices.end() && *it == i)
+            {
+                ++it;
+                continue;
+            }
+            outliers->indices.push_back(i);
+        }
+    }
+
+    // 由上一次平面与圆拟合的质量估计位姿协方差, 6x6 行优先, 顺序与 geometry_msgs/PoseWithCovariance 一致
+    // (x, y, z, rot_x, rot_y, rot_z), 与拟合输入同一坐标系; 绕法向的转角由约定确定, 对应方差为0
+    void poseCovariance(double *covariance) const { poseCovariance(plane_ransac.quality(), covariance); }
+
+    // 平面不是由 plane_ransac 拟合时(如 OrganizedPlane), 传入其拟合质量; plane 仍需为所用的平面系数
+    void poseCovariance(const PlaneRansac::Quality &plane_quality, double *covariance) const
+    {
+        const auto &circle_quality = circle_fit.quality();
+        Eigen::Vector3d n(plane->values[0], plane->values[1], plane->values[2]);
+        n.normalize();
+
+        // 位置: 圆心协方差 + 平面沿法向的位置误差
+        const Eigen::Matrix3d position = circle_quality.center_covariance + plane_quality.offset_variance * n * n.transpose();
+
+        // 姿态: 法向扰动 δn ⟂ n 对应小角度旋转 δθ = n × δn
+        Eigen::Matrix3d skew;
+        skew << 0, -n[2], n[1], n[2], 0, -n[0], -n[1], n[0], 0;
+        const Eigen::Matrix3d rotation = skew * plane_quality.normal_covariance * skew.transpose();
+
+        Eigen::Map<Eigen::Matrix<double, 6, 6, Eigen::RowMajor>> cov(covariance);
+        cov.setZero();
+        cov.topLeftCorner<3, 3>() = position;
+        cov.bottomRightCorner<3, 3>() = rotation;
+    }
+
+    // 位置的最大标准差(米), 即位置协方差最大特征值的平方根, 用作单一的质量指标
+    static double positionSigma(const double *covariance)
+    {
+        const Eigen::Map<const Eigen::Matrix<double, 6, 6, Eigen::RowMajor>> cov(covariance);
+        const Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(cov.topLeftCorner<3, 3>());
+        return std::sqrt(std::max(solver.eigenvalues()[2], 0.0));
+    }
+};
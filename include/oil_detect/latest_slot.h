@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <condition_variable>
+
+// 流水线相邻两级之间容量为1的槽, 只保留最新值: 后级来不及处理时旧值被覆盖(计为丢弃), 延迟不随积压增长
+// put/take 均与槽内对象交换而非拷贝, 被覆盖或已处理完的对象回到调用方手中, 其缓存(点云等)可直接复用
+template <typename T>
+class LatestSlot
+{
+public:
+    // 放入 value, 返回后 value 为槽内原有对象(被覆盖的旧值或上次取走后留下的对象); 已关闭时返回 false
+    bool put(T &value)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            if (closed_)
+            {
+                return false;
+            }
+            if (full_)
+            {
+                ++dropped_;
+            }
+            std::swap(value_, value);
+            full_ = true;
+        }
+        cond_.notify_one();
+        return true;
+    }
+
+    // 等待新值并与 value 交换, 超时或已关闭返回 false
+    bool take(T &value, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> guard(lock_);
+        if (!cond_.wait_for(guard, timeout, [this] { return full_ || closed_; }) || !full_)
+        {
+            return false;
+        }
+        std::swap(value_, value);
+        full_ = false;
+        return true;
+    }
+
+    // 关闭后 put 失败, 等待中的 take 立即返回
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            closed_ = true;
+            full_ = false;
+        }
+        cond_.notify_all();
+    }
+
+    bool closed() const
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        return closed_;
+    }
+
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    mutable std::mutex lock_;
+    std::condition_variable cond_;
+    T value_;
+    bool full_ = false;
+    bool closed_ = false;
+    std::atomic<uint64_t> dropped_{0};
+};
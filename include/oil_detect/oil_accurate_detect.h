@@ -9,6 +9,9 @@
 #include <pcl/io/pcd_io.h>
 #include <pcl/visualization/cloud_viewer.h>
 
+#include "oil_detect/detector_workspace.h"
+#include "oil_detect/voxel_downsample.h"
+
 class OilAccurateDetect
 {
 public:
@@ -35,6 +38,12 @@ public:
         return oil_quat_;
     }
 
+    // 位姿协方差, 6x6 行优先, 见 DetectorWorkspace::poseCovariance
+    const double *getCovariance()
+    {
+        return oil_cov_;
+    }
+
     const PCLPointCloud::Ptr getOriginalCloud()
     {
         return cloud_;
@@ -63,20 +72,30 @@ public:
 private:
     int poseDetect();
 
-    void planeToQuat(pcl::ModelCoefficients coef, float *quat);
+    void planeToQuat(const pcl::ModelCoefficients &coef, float *quat);
 
-    std::vector<int> extractAbovePlane(PCLPointCloud::Ptr cloud, float A, float B, float C, float D, float min_dis, float max_dis);
-
-    std::vector<float> correctionNormalDirection(PCLPointCloud::Ptr cloud, float A, float B, float C, float D);
+    // 对体素点云做一次并行遍历: 到平面距离 <= plane_thr 的点写入 plane_cloud_,
+    // 距离在 [min_dis, max_dis] 的点写入 not_plane_cloud_, 并统计平面两侧距离 >= min_dis 的点数
+    void classifyPoints(const pcl::ModelCoefficients &coef, float plane_thr, float min_dis, float max_dis);
 
 private:
     /* data */
     float oil_trans_[3];
     float oil_quat_[4];
+    double oil_cov_[36] = {0};
 
     PCLPointCloud::Ptr cloud_;
     PCLPointCloud::Ptr cloud_voxel_;
     PCLPointCloud::Ptr oil_cloud_;
     PCLPointCloud::Ptr plane_cloud_;
     PCLPointCloud::Ptr not_plane_cloud_;
+
+    std::vector<uint8_t> labels_;      // classifyPoints 的逐点标记, bit0: 平面, bit1: 平面上方
+    std::vector<size_t> chunk_counts_; // 各线程段内的平面点数与上方点数
+    size_t positive_num_ = 0, negative_num_ = 0;
+
+    PCLPointCloud::Ptr voxel_buffer_; // 降采样输出, cloud_voxel_ 指向它或输入点云
+    VoxelDownsample voxel_filter_;
+
+    DetectorWorkspace workspace_; // 平面(1mm阈值, 自适应迭代)与圆拟合的缓存
 };
@@ -1,6 +1,8 @@
 #pragma onece
 
 // system
+#include <mutex>
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <iostream>
@@ -10,10 +12,12 @@
 #include <eigen_conversions/eigen_msg.h>
 #include <pcl_conversions/pcl_conversions.h>
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <visualization_msgs/Marker.h>
 #include <visualization_msgs/MarkerArray.h>
 
+#include <geometry_msgs/PoseWithCovarianceStamped.h>
 #include <tf/transform_broadcaster.h>
 #include <tf_conversions/tf_eigen.h>
 
@@ -34,10 +38,76 @@
 #include "opencv2/imgproc.hpp"
 
 #include "camera/camera_receiver.h"
+#include "camera/tf_buffer_service.h"
+#include "oil_detect/circle_tracker.h"
+#include "oil_detect/detector_workspace.h"
+#include "oil_detect/latest_slot.h"
+#include "oil_detect/organized_plane.h"
+#include "oil_detect/pose_tracker.h"
 
 typedef pcl::PointCloud<pcl::PointXYZRGBA> PointCloudRGBA;
 typedef pcl::PointCloud<pcl::PointNormal> PointCloudPointNormal;
 
+// 单帧在流水线各级之间传递的数据: 采集级写入图像与点云, 2D检测级写入矩形与中心, 3D拟合级写入位姿
+// 图像与点云借用自接收器的只读帧 source, 不拷贝
+struct PoseFrame
+{
+    uint64_t seq = 0;
+    ros::Time stamp;
+    int level = 0; // 所用的降采样层
+    CloudFramePtr source;
+    cv::Mat color;
+    cv::Mat depth; // 与 color 同尺寸的深度图
+    cv::Mat lookup_x, lookup_y;
+    pcl::PointCloud<pcl::PointXYZRGBA>::ConstPtr cloud; // 原始点云
+
+    bool detected = false; // 2D检测(或验证)成功
+    bool verified = false; // true: 跟踪预测经验证成立, 未做完整检测
+    bool posed = false;    // 位姿经跟踪滤波接受, 已发布
+    cv::Rect rect;         // 加油口外接矩形
+    cv::Point center;      // 加油口中心点
+    float pixel_radius = 0; // 图像中的圆半径(像素, 当前层)
+    float radius = 0;      // 拟合的圆半径(米)
+
+    Eigen::VectorXf coef = Eigen::VectorXf::Zero(4, 1); // 平面参数
+    Eigen::Vector3d trans = Eigen::Vector3d::Zero();    // 加油口坐标系平移矩阵
+    Eigen::Matrix3d rot = Eigen::Matrix3d::Identity();  // 加油口坐标系旋转矩阵
+    double covariance[36] = {0};                        // 位姿协方差, 见 DetectorWorkspace::poseCovariance
+
+    // 不再需要图像与点云时尽早归还, 接收器的缓存池才能复用该帧
+    void release()
+    {
+        source.reset();
+        cloud.reset();
+        color.release();
+        depth.release();
+        lookup_x.release();
+        lookup_y.release();
+    }
+};
+
+// 显示线程读取的检测结果快照: 检测线程每处理完一帧发布一份(只含指针与位姿, 不拷贝图像),
+// 显示线程按自己的频率取最新的一份, 检测不等待显示
+struct ShowSnapshot
+{
+    uint64_t seq = 0;
+    ros::Time stamp;
+    uint64_t processed = 0; // 检测线程累计处理的帧数, 显示线程据此计算检测帧率
+    CloudFramePtr source;   // 只读帧, 保存时取原始分辨率的图像与点云
+    cv::Mat color;          // 检测所用层的彩色图
+    pcl::PointCloud<pcl::PointXYZRGBA>::ConstPtr cloud; // 检测所用层的点云, 显示时再抽稀
+
+    bool detected = false;
+    bool verified = false;
+    bool posed = false;
+    cv::Rect rect;
+    cv::Point center;
+    float pixel_radius = 0;
+    Eigen::Vector3d trans = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d rot = Eigen::Matrix3d::Identity();
+};
+typedef std::shared_ptr<const ShowSnapshot> ShowSnapshotPtr;
+
 class OilFillerPose
 {
 public:
@@ -47,58 +117,126 @@ public:
     */
     // OilFillerPose(ros::NodeHandle &node, std::string camera_frame, int rate);
 
-    OilFillerPose(ros::NodeHandle &node, std::shared_ptr<CameraReceiver> camera_receiver, std::string camera_frame, int rate);
+    OilFillerPose(ros::NodeHandle &node, std::shared_ptr<CameraReceiver> camera_receiver, std::string camera_frame, int rate,
+                  std::shared_ptr<TfBufferService> tf_buffer = TfBufferService::instance());
 
     /**
      * \brief Run the ROS node. Loops while waiting for incoming ROS messages.
     */
-    void run(int loop_rate); // 仅进行姿态检测
+    void run(int loop_rate); // 仅进行姿态检测, 采集/2D检测/3D拟合/发布分级并行
 
-    void runShow(int loop_rate); // 姿态检测加显示
+    void runShow(int loop_rate); // 姿态检测加显示, 检测与 run() 相同, 显示线程只读取结果快照
+
+    void stop() { quit_ = true; } // 可在任意线程调用, run()/runShow() 随后返回
 
     void imageViewer(int loop_rate);
     void cloudViewer(int loop_rate);
 
     void keyboardEvent(const pcl::visualization::KeyboardEvent &event, void *viewer_void);
 
-    void saveCloudAndImages();
+    void saveCloudAndImages(const ShowSnapshot &snap);
 
-    bool ofDetect(); // 加油口检测
+    bool ofVerify(PoseFrame &f); // 用跟踪预测验证当前帧, 通过时跳过 ofDetect 与 ofPlaneCal
 
-    bool ofPlaneCal(); // 加油口平面拟合
+    bool ofDetect(PoseFrame &f); // 加油口检测
 
-    void ofCenterCal(); // 加油口中心世界坐标计算
+    bool ofPlaneCal(PoseFrame &f); // 加油口平面拟合
 
-    void ofPoseCal(); // 加油口姿态解算
+    void ofCenterCal(PoseFrame &f); // 加油口中心世界坐标计算
 
-    void ofPoseShow(pcl::visualization::PCLVisualizer::Ptr &visualizer); // 显示加油口相关信息
+    void ofPoseCal(PoseFrame &f); // 加油口姿态解算
 
-    void publishTF(); // 发布加油口姿态
+    bool ofTrack(PoseFrame &f); // 跟踪滤波, 结果写回 f 的位姿与协方差; 量测被拒绝时返回 false
 
-    void getCameraPose(std::string source_frame, std::string target_frame, tf::StampedTransform &transform, std::string save_path);
+    void ofPoseShow(pcl::visualization::PCLVisualizer::Ptr &visualizer, const ShowSnapshot &snap); // 显示加油口相关信息
 
-private:
-    // 加油口相关参数
-    cv::Rect of_rect;                                   // 加油口外接矩形
-    cv::Point of_center;                                // 加油口中心点
-    pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloud;      // 原始点云
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_of;       // 加油口点云
-    Eigen::VectorXf coef = Eigen::VectorXf::Zero(4, 1); // 平面参数
-    Eigen::Matrix3Xd trans_buff_;
-    const int buff_size_;
+    void publishTF(const PoseFrame &f); // 发布加油口姿态(TF 及带协方差的位姿话题)
+
+    // 查询 stamp 时刻的相机位姿
+    bool getCameraPose(std::string source_frame, std::string target_frame, const ros::Time &stamp,
+                       tf::StampedTransform &transform, std::string save_path = "");
 
-    Eigen::Vector3d trans;      // 加油口坐标系平移矩阵
-    Eigen::Matrix3d rot_matrix; // 加油口坐标系旋转矩阵
+    // 设置检测所用的降采样层, level>0 时每 refine_interval 帧用原始分辨率精检一次(0 表示不精检)
+    void setDetectLevel(int level, int refine_interval = 0, PyramidMode mode = PyramidMode::MinPool);
 
-    bool running = false;
+    // 是否启用跟踪窗口检测(默认启用)
+    void setTracking(bool enable) { tracker_.params().enable = enable; }
 
-    cv::Mat color_draw;
+    // 整帧圆检测是否在1/2分辨率上进行(默认否)
+    void setHalfResolution(bool enable) { tracker_.params().half_resolution = enable; }
+
+    // 单帧拟合的位置标准差超过该值(米)时不用于跟踪, 不发布
+    void setMaxPositionSigma(double sigma) { max_position_sigma_ = sigma; }
+
+    // run() 是否分级并行执行(默认是), 否则各步骤在同一线程内串行
+    void setPipeline(bool enable) { pipeline_ = enable; }
+
+    // 平面与圆孔边缘是否在有组织点云上以霍夫圆为种子提取(默认是), 失败或点云无组织时回退到 RANSAC
+    void setOrganizedPlane(bool enable) { organized_plane_enable_ = enable; }
+
+    // 跟踪稳定时是否只验证预测而跳过完整检测(默认是)
+    void setVerifyOnly(bool enable) { pose_tracker_.params().verify = enable; }
+
+    // 检测循环中处理的回调队列(默认全局队列, 即 ros::spinOnce()); nodelet 中为其自己的队列
+    void setCallbackQueue(ros::CallbackQueue *queue) { callback_queue_ = queue; }
+
+    // 显示线程的刷新频率与点云显示的抽稀步长(默认 10Hz, 每2行2列取1点)
+    void setShowRate(int rate, int step = 2)
+    {
+        show_rate_ = std::max(rate, 1);
+        show_step_ = std::max(step, 1);
+    }
+
+private:
+    void grabFrame(PoseFrame &f, const CloudFramePtr &source); // 借用接收器的一帧(按所需层), 不拷贝
+
+    void runSerial(int loop_rate);
+    void runPipeline(int loop_rate);
+    void spinOnce();
+
+    // 平面与圆拟合完成后的质量门限, 通过时写入 f 的平面、圆心与半径
+    bool acceptFit(PoseFrame &f, const PlaneRansac::Quality &plane_quality);
+
+    // 一帧处理结束(成功或在任一步失败)时调用, 显示开启时发布结果快照
+    void showFrame(const PoseFrame &f);
+    ShowSnapshotPtr getSnapshot()
+    {
+        std::lock_guard<std::mutex> guard(show_lock_);
+        return show_snapshot_;
+    }
+
+    // 串行执行(及显示)时的当前帧
+    PoseFrame frame_;
+
+    // 加油口相关参数, tracker_ 只在2D检测级使用, workspace_/cloud_of 只在3D拟合级使用
+    CircleTracker tracker_;                       // 加油口圆检测/跟踪
+    DetectorWorkspace workspace_;                 // 平面与圆拟合的缓存
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_of; // 加油口点云
+    OrganizedPlane organized_plane_;              // 有组织点云的平面与边缘提取
+    bool organized_plane_enable_ = true;
+    double max_position_sigma_ = 0.005;           // 质量门限(米)
+
+    PoseTracker pose_tracker_; // 位姿滤波, 2D检测级验证、3D拟合级更新
+    std::mutex pose_lock_;
+
+    std::atomic<bool> running{false}; // 显示线程运行中
+    std::atomic<bool> quit_{false};   // 显示窗口中按 q 退出, 或 stop()
+    ros::CallbackQueue *callback_queue_ = nullptr;
+
+    ShowSnapshotPtr show_snapshot_; // 最新的结果快照
+    std::mutex show_lock_;
+    int show_rate_ = 10;
+    int show_step_ = 2;
 
     size_t frame = 0;
-    int frame_rate_ = 0;
     int rate_;
-    bool save = false;
+    std::atomic<bool> save{false};
     bool update = false;
+    int detect_level_ = 0;    // 默认检测层
+    int refine_interval_ = 0; // 精检间隔
+    size_t iteration_ = 0;
+    std::atomic<uint64_t> processed_{0}; // 处理的不同帧数
+    bool pipeline_ = true;
     std::ostringstream oss;
     pcl::PCDWriter writer;
     std::vector<int> params;
@@ -106,5 +244,7 @@ private:
     std::shared_ptr<CameraReceiver> receiver;
 
     std::string camera_frame_;
+    std::shared_ptr<TfBufferService> tf_buffer_;
     tf::TransformBroadcaster broadcaster;
+    ros::Publisher pose_pub_; // geometry_msgs/PoseWithCovarianceStamped
 };
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <vector>
 #include <string>
 #include <thread>
+#include <atomic>
 
 #include <moveit/move_group_interface/move_group_interface.h>
 #include <moveit/planning_scene_interface/planning_scene_interface.h>
@@ -12,6 +13,7 @@
 #include "camera/camera_receiver.h"
 #include "oil_detect/oil_rough_detect.h"
 #include "oil_detect/oil_accurate_detect.h"
+#include "oil_detect/oil_volume_detect.h"
 #include "fusion/tsdf_fusion.h"
 #include "fusion/fusion.h"
 #include "fusion/topics_capture.h"
@@ -34,11 +36,22 @@ public:
         return oil_quat_;
     }
 
+    const double *getOilCovariance()
+    {
+        return oil_cov_;
+    }
+
     void imageViewer(int loop_rate);
     void cloudViewer(int loop_rate);
 
     void show(int loop_rate);
 
+    // true: 直接在融合体素上精定位, 失败时再导出点云走 OilAccurateDetect
+    void setVolumeDetect(bool enable)
+    {
+        volume_detect_ = enable;
+    }
+
 private:
     int multiViewDataCollect(float *oil_position, std::string output_folder);
 
@@ -49,6 +62,13 @@ private:
 
     OilRoughDetect oil_rough_detecter_;
     OilAccurateDetect oil_accurate_detecter_;
+    OilVolumeDetect oil_volume_detecter_;
+    bool volume_detect_ = true;
+
+    // 显示线程, 析构时停止并等待退出
+    std::thread image_viewer_thread_;
+    std::thread cloud_viewer_thread_;
+    std::atomic<bool> show_running_{false};
 
     std::string tsdf_data_floder_;
     Fusion *fusion_;
@@ -61,6 +81,7 @@ private:
 
     const float *oil_pos_;
     const float *oil_quat_;
+    const double *oil_cov_;
 
     // 机械臂运动规划相关
     // 运动规划接口
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <ros/ros.h>
+
+#include "oil_detect/oil_detect_tsdf.h"
+
+#include <oil_pose_detector/OilPoseDetector.h>
+#include <oil_pose_detector/OilPoseDetectorRequest.h>
+#include <oil_pose_detector/OilPoseDetectorResponse.h>
+
+class DetectOilWithReconstructServer
+{
+
+public:
+    DetectOilWithReconstructServer() = delete;
+    // external_spin: 由外部(nodelet管理器)负责spin, 相机接收器不再创建自己的spinner
+    // stop: 外部停止标志, 置位后构造时不再等待相机首帧(nodelet 卸载)
+    DetectOilWithReconstructServer(std::string service_name, ros::NodeHandle &nh, bool external_spin = false,
+                                   const std::atomic<bool> *stop = nullptr);
+    ~DetectOilWithReconstructServer(){};
+
+    bool serverCallBack(oil_pose_detector::OilPoseDetector::Request &req, oil_pose_detector::OilPoseDetector::Response &res);
+
+private:
+    void init();
+    /* data */
+    std::unique_ptr<OilDetectTsdf> oil_detecter;
+
+    ros::NodeHandle nh_;
+    ros::ServiceServer server_;
+    bool external_spin_;
+    const std::atomic<bool> *stop_;
+};
@@ -13,6 +13,10 @@
 #include <tf/transform_broadcaster.h>
 #include <tf_conversions/tf_eigen.h>
 
+#include "camera/tf_buffer_service.h"
+#include "oil_detect/circle_tracker.h"
+#include "oil_detect/detector_workspace.h"
+
 class OilRoughDetect
 {
 public:
@@ -22,13 +26,21 @@ public:
     using PCLPointCloud = pcl::PointCloud<PCLPoint>;
 
 public:
-    OilRoughDetect(std::string color_frame);
+    OilRoughDetect(std::string color_frame, std::shared_ptr<TfBufferService> tf_buffer = TfBufferService::instance());
     ~OilRoughDetect();
 
-    int detect_once(const cv::Mat &color, const cv::Mat &depth, const PCLPointCloudRGB::Ptr cloud, float *oil_pose);
+    // stamp: 图像时间戳, 用于查询拍摄时刻的相机位姿
+    int detect_once(const cv::Mat &color, const cv::Mat &depth, const PCLPointCloudRGB::Ptr cloud, float *oil_pose,
+                    const ros::Time &stamp = ros::Time(0));
 
     void saveDataFrame(const std::string save_folder, const std::string save_num);
 
+    // 彩色相机焦距(像素), 用于由深度预测加油口的像素半径; 0 表示不使用深度先验
+    void setFocalLength(float fx) { fx_ = fx; }
+
+    // 每次检测并行评估的候选圆个数
+    void setNumCandidates(int num) { num_candidates_ = std::max(num, 1); }
+
     float *getPositionInCamera()
     {
         return oil_pos_in_camera_;
@@ -40,13 +52,37 @@ public:
     }
 
 private:
-    int roiDetect();
-    int getPosFromRoi();
-
-    void computerMeanValue(PCLPointCloud::Ptr cloud, std::vector<int> indices, float *pos);
-    void computerMeanValue(PCLPointCloud::Ptr cloud, float *pos);
-
-    void getCameraPose(std::string source_frame, std::string target_frame);
+    // 单个候选圆的评估结果
+    struct CandidateResult
+    {
+        bool valid = false;
+        cv::Rect roi;
+        int inliers = 0;
+        int rim_points = 0;       // 平面外拟合到圆孔边缘的点数
+        float rim_radius = 0;     // 边缘圆的半径(米)
+        float pos[3] = {0, 0, 0}; // 平面内点均值, 相机坐标系
+        float score = 0;
+    };
+
+    static constexpr float kRadiusTolerance = 0.15f; // 边缘半径与像素换算半径相对加油口实际半径的最大误差
+    static constexpr int kMinRimPoints = 20;         // 边缘圆的最少局内点数
+    static constexpr int kRimSectors = 12;           // 边缘点按圆心角分区, 检查边缘是否成圈
+    static constexpr int kMinRimSectors = 9;         // 边缘点至少覆盖的分区数
+    static constexpr float kMinInsideRatio = 0.8f;   // 平面外的点落在边缘圆内的最小比例
+
+    int roiDetect();     // 得到候选圆
+    int getPosFromRoi(); // 并行评估候选圆, 取得分最高者
+
+    cv::Rect candidateRoi(const CircleDetection &circle_det) const;
+    void evaluateCandidate(const CircleDetection &circle_det, DetectorWorkspace &workspace, CandidateResult &result) const;
+    // 边缘圆是否为一整圈圆孔: 边缘局内点覆盖足够多的圆心角分区, 且平面外的点大多在圆内
+    static bool isClosedRim(const PCLPointCloud &cloud, const std::vector<int> &outliers, const std::vector<int> &rim,
+                            const pcl::ModelCoefficients &circle, float threshold);
+
+    static void computerMeanValue(const PCLPointCloud::Ptr cloud, const std::vector<int> &indices, float *pos);
+    static void computerMeanValue(const PCLPointCloud::Ptr cloud, float *pos);
+
+    bool getCameraPose(std::string source_frame, std::string target_frame, const ros::Time &stamp);
     void saveCameraPose(std::string save_path);
 
     void convertPosToWorld(float *oil_pos_in_camera, float *oil_pos_in_world);
@@ -57,7 +93,9 @@ private:
     float oil_pos_in_world_[3];
     std::string color_frame_;
 
+    std::shared_ptr<TfBufferService> tf_buffer_;
     tf::StampedTransform camera_pose_;
+    ros::Time stamp_;
 
     cv::Mat color_;
     cv::Mat color_draw_;
@@ -66,4 +104,10 @@ private:
     PCLPointCloudRGB::Ptr cloud_;
 
     cv::Rect oil_roi_;
+    CircleTracker tracker_; // 连续检测时在上次结果附近搜索
+    std::vector<CircleDetection> candidates_;
+    std::vector<CandidateResult> results_;
+    std::vector<DetectorWorkspace> workspaces_; // 每个候选一份, 多帧复用
+    int num_candidates_ = 4;
+    float fx_ = 0;
 };
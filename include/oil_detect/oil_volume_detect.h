@@ -0,0 +1,101 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "fusion/tsdf_volume.h"
+#include "oil_detect/detector_workspace.h"
+
+// 直接在融合后的 TSDF 体素上精定位, 不导出点云:
+// 1. 沿 base 相机光轴(体素 z 方向)逐列查找 SDF 由正变负的零点, 得到表面采样点, 拟合平面
+// 2. 以粗定位位置在平面上的投影为起点, 在平面内沿一圈射线步进, 每一步沿法向查询表面高度,
+//    表面高度从加油口高度跌落到平面附近处即为边缘, 对边缘点拟合圆
+// 输出与 OilAccurateDetect 一致: 世界坐标系下的圆心与以平面法向为 z 轴的四元数
+class OilVolumeDetect
+{
+public:
+    using PCLPoint = pcl::PointXYZ;
+    using PCLPointCloud = pcl::PointCloud<PCLPoint>;
+
+    struct Params
+    {
+        int column_stride = 2;        // 查找零点时的列间隔(体素)
+        float min_height = 0.01f;     // 加油口相对平面的高度范围(米), 与 OilAccurateDetect 一致
+        float max_height = 0.1f;
+        int num_rays = 180;           // 每圈射线数
+        float max_ray_length = 0.07f; // 射线最大长度(米)
+        int rounds = 2;               // 以上一轮拟合的圆心重新发射射线的轮数
+    };
+
+public:
+    OilVolumeDetect();
+    ~OilVolumeDetect();
+
+    // rough_pos: 粗定位位置(世界坐标系), 即融合时体素的中心
+    int detect_once(const TsdfVolume &volume, const float *rough_pos);
+
+    void saveDataFrame(const std::string save_folder, const std::string save_num);
+
+    const float *getPosition()
+    {
+        return oil_trans_;
+    }
+
+    const float *getQuaternion()
+    {
+        return oil_quat_;
+    }
+
+    // 位姿协方差(世界坐标系), 6x6 行优先, 见 DetectorWorkspace::poseCovariance
+    const double *getCovariance()
+    {
+        return oil_cov_;
+    }
+
+    // 边缘点(世界坐标系)
+    const PCLPointCloud::Ptr getOilCloud()
+    {
+        return oil_cloud_;
+    }
+
+    Params &params() { return params_; }
+
+private:
+    // 沿体素 z 方向逐列查找第一个由正变负的零点, 结果写入 workspace_.cloud (base 相机坐标系)
+    void findZeroCrossings();
+
+    // 从 p 沿 -normal_ 步进查找表面, 返回表面到平面的高度; 未观测或无表面时返回 false
+    bool surfaceHeight(const Eigen::Vector3f &p, float &height) const;
+
+    // 以平面内 (cu, cv) 为中心发射一圈射线, 边缘点写入 rim_cloud_
+    void marchRays(float cu, float cv);
+
+    void toWorld(const PCLPointCloud &in, PCLPointCloud &out) const;
+
+private:
+    Params params_;
+    const TsdfVolume *volume_ = nullptr;
+
+    float oil_trans_[3];
+    float oil_quat_[4];
+    double oil_cov_[36] = {0};
+
+    // 平面坐标系(base 相机坐标系下): 法向指向相机一侧
+    Eigen::Vector3f normal_, plane_origin_, e1_, e2_;
+    Eigen::Matrix4f base2world_;
+
+    std::vector<float> prev_;              // findZeroCrossings 中每列上一个体素的 tsdf
+    std::vector<float> rim_u_, rim_v_, rim_h_; // 每条射线的边缘点, 平面坐标与高度
+
+    PCLPointCloud::Ptr rim_cloud_;     // 边缘点(base 相机坐标系)
+    PCLPointCloud::Ptr surface_cloud_; // 保存用, 世界坐标系
+    PCLPointCloud::Ptr oil_cloud_;
+
+    DetectorWorkspace workspace_; // 零点平面拟合与边缘圆拟合
+};
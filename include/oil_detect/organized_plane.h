@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+
+#include <Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+
+#include <opencv2/opencv.hpp>
+
+#include "oil_detect/plane_ransac.h"
+
+// 有组织点云上的加油口平面与圆孔边缘提取, 替代 ROI 展平为无组织点云后的平面 RANSAC:
+// - 法向由积分图计算(平均三维梯度, 同 IntegralImageNormalEstimation::AVERAGE_3D_GRADIENT), 每像素常数时间
+// - 以霍夫圆外侧一圈像素为种子, 按法向夹角与到种子平面的距离在像素邻域上区域生长, 取最大的连通区域为平面
+// - 圆孔边缘取霍夫圆附近深度不连续处较近一侧的像素(遮挡边缘), 用于平面内的圆拟合
+// 只处理 ROI 内的像素且不并行, 缓存在多帧间复用
+class OrganizedPlane
+{
+public:
+    struct Params
+    {
+        float depth_change_factor = 0.02f; // 相邻像素深度差超过 深度*该值 时视为不连续
+        int normal_window = 3;             // 法向平滑窗口半径(像素)
+        float max_angle = 0.15f;           // 区域生长时法向与平面法向的最大夹角(弧度)
+        float distance_threshold = 0.005f; // 区域生长时点到平面的最大距离(米)
+        int seeds = 16;                    // 种子个数, 均匀分布在种子圈上
+        float seed_ratio = 1.5f;           // 种子圈半径与霍夫圆半径之比
+        float rim_band = 0.4f;             // 只在半径 [1-band, 1+band]·r 的圆环内查找边缘像素
+        int min_plane_points = 100;        // 平面像素数下限
+        int min_rim_points = 10;           // 边缘像素数下限
+    };
+
+    OrganizedPlane() : OrganizedPlane(Params()) {}
+    explicit OrganizedPlane(const Params &params) : params_(params) {}
+
+    // 拷贝 ROI 内的坐标到 SoA 缓存, 无效点置为 NaN; 输出的下标均为输入点云中的下标
+    template <typename PointT>
+    void setInputCloud(const pcl::PointCloud<PointT> &cloud, const cv::Rect &roi);
+
+    // center/radius: 霍夫圆(像素, 与输入点云同一分辨率); plane 与 PlaneRansac 一致为 (a, b, c, d), 法向单位化
+    bool segment(const cv::Point2f &center, float radius, pcl::PointIndices &plane_inliers,
+                 pcl::ModelCoefficients &plane, pcl::PointIndices &rim);
+
+    // 上一次 segment() 成功时的平面拟合质量, 与 PlaneRansac::quality() 含义相同
+    const PlaneRansac::Quality &quality() const { return quality_; }
+
+    Params &params() { return params_; }
+
+private:
+    bool valid(int i) const { return !std::isnan(z_[i]); }
+
+    // i 与 j 相邻且深度连续
+    bool connected(int i, int j) const
+    {
+        const float limit = params_.depth_change_factor * z_[i];
+        return valid(i) && valid(j) && std::abs(z_[i] - z_[j]) <= limit;
+    }
+
+    void computeNormals();
+
+    // 从 seed 出发在连续且满足平面条件的像素上生长, 返回像素数; 结果写入 region_
+    int grow(int seed, const Eigen::Vector4f &plane, int label);
+
+    // 对 region_ 中的像素做最小二乘平面拟合, 同时估计质量
+    bool fitPlane(Eigen::Vector4f &plane);
+
+    int toCloudIndex(int i) const { return (roi_.y + i / roi_.width) * cloud_width_ + roi_.x + i % roi_.width; }
+
+private:
+    Params params_;
+    PlaneRansac::Quality quality_;
+
+    cv::Rect roi_;
+    int cloud_width_ = 0;
+    std::vector<float> x_, y_, z_; // ROI 内的坐标, 行优先
+    std::vector<float> nx_, ny_, nz_; // 法向, 无效时为 NaN
+    std::vector<double> integral_;    // 水平/垂直梯度及其计数的积分图, 每像素8个通道
+    std::vector<int> labels_;         // 区域生长的标记
+    std::vector<int> stack_;
+    std::vector<int> region_, best_region_;
+};
+
+template <typename PointT>
+void OrganizedPlane::setInputCloud(const pcl::PointCloud<PointT> &cloud, const cv::Rect &roi)
+{
+    roi_ = roi & cv::Rect(0, 0, (int)cloud.width, (int)cloud.height);
+    cloud_width_ = (int)cloud.width;
+    const int n = roi_.area();
+    x_.resize(n);
+    y_.resize(n);
+    z_.resize(n);
+    for (int r = 0; r < roi_.height; r++)
+    {
+        const PointT *row = &cloud.points[(roi_.y + r) * cloud.width + roi_.x];
+        float *x = &x_[r * roi_.width], *y = &y_[r * roi_.width], *z = &z_[r * roi_.width];
+        for (int c = 0; c < roi_.width; c++)
+        {
+            const PointT &p = row[c];
+            const bool ok = std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z) && p.z > 0;
+            x[c] = p.x;
+            y[c] = p.y;
+            z[c] = ok ? p.z : NAN;
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+
+#include <Eigen/Core>
+
+#include <pcl/point_cloud.h>
+#include <pcl/ModelCoefficients.h>
+#include <pcl/PointIndices.h>
+
+// 平面 RANSAC, 替代 SACSegmentation(SACMODEL_PLANE):
+// - 按当前最优模型的局内点比例自适应终止, 不再固定跑满最大迭代次数
+// - 点云按 x/y/z 分开连续存放(SoA), 局内点统计可向量化
+// - 每批假设先由同一个随机数发生器顺序生成, 再用 OpenMP 并行评分, 结果与线程数无关
+// - 相同输入与种子得到相同结果
+class PlaneRansac
+{
+public:
+    struct Params
+    {
+        float distance_threshold = 0.001f; // 局内点到平面的最大距离(米)
+        int max_iterations = 10000;        // 迭代次数上限
+        float probability = 0.99f;         // 至少抽到一次全局内点样本的概率, 用于自适应终止
+        int batch_size = 64;               // 每批并行评分的假设个数
+        uint32_t seed = 12345;             // 随机种子
+        bool refine = false;               // 用局内点最小二乘重新估计系数(局内点不变), 同 setOptimizeCoefficients(true)
+    };
+
+    // 拟合质量, 由最终局内点的残差闭式估计, 不额外遍历点云
+    struct Quality
+    {
+        int inliers = 0;
+        float rms = 0;                                               // 局内点到平面距离的均方根(米)
+        Eigen::Matrix3d normal_covariance = Eigen::Matrix3d::Zero(); // 单位法向的协方差
+        double offset_variance = 0;                                  // 平面沿法向位置(局内点质心处)的方差
+    };
+
+    PlaneRansac() : PlaneRansac(Params()) {}
+    explicit PlaneRansac(const Params &params) : params_(params) {}
+
+    // 拷贝有效点到 SoA 缓存, 缓存在多次调用间复用
+    template <typename PointT>
+    void setInputCloud(const pcl::PointCloud<PointT> &cloud)
+    {
+        x_.clear();
+        y_.clear();
+        z_.clear();
+        index_.clear();
+        for (int i = 0; i < (int)cloud.size(); i++)
+        {
+            const PointT &p = cloud.points[i];
+            if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+            {
+                continue;
+            }
+            x_.push_back(p.x);
+            y_.push_back(p.y);
+            z_.push_back(p.z);
+            index_.push_back(i);
+        }
+    }
+
+    // coefficients: 单位法向量 (a, b, c) 与 d, 与 SACSegmentation 一致; inliers 为输入点云中的下标
+    bool segment(pcl::PointIndices &inliers, pcl::ModelCoefficients &coefficients);
+
+    // 上一次 segment() 实际评估的假设个数
+    int iterations() const { return iterations_; }
+
+    // 上一次 segment() 成功时的拟合质量
+    const Quality &quality() const { return quality_; }
+
+    Params &params() { return params_; }
+
+private:
+    // 由三个点构造平面, 共线时返回 false
+    bool hypothesis(int i0, int i1, int i2, float *plane) const;
+
+    int countInliers(const float *plane) const;
+
+private:
+    Params params_;
+    int iterations_ = 0;
+    Quality quality_;
+
+    std::vector<float> x_, y_, z_;
+    std::vector<int> index_;
+    std::vector<float> batch_planes_; // 每个假设4个系数
+    std::vector<int> batch_scores_;
+};
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+
+#include <Eigen/Dense>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include <opencv2/opencv.hpp>
+
+// 由归一化射线表近似得到的针孔内参(忽略畸变), 用于把预测的三维点投影回图像
+struct Pinhole
+{
+    float fx = 0, fy = 0, cx = 0, cy = 0;
+
+    bool valid() const { return fx > 0 && fy > 0; }
+
+    // lookup_x/lookup_y 见 CameraReceiver::getLookupX/Y, 在图像中心处取差分
+    static Pinhole fromLookup(const cv::Mat &lookup_x, const cv::Mat &lookup_y);
+
+    cv::Point2f project(const Eigen::Vector3d &p) const
+    {
+        return cv::Point2f((float)(fx * p[0] / p[2] + cx), (float)(fy * p[1] / p[2] + cy));
+    }
+};
+
+// 加油口位姿跟踪(相机坐标系): 平移为匀速模型, 姿态为匀位置模型的卡尔曼滤波;
+// 量测协方差取自拟合质量(DetectorWorkspace::poseCovariance), 新息的马氏距离超过门限时拒绝该量测,
+// 连续拒绝多次视为目标已变化, 以新量测重新初始化.
+// 跟踪稳定时只验证预测: 在预测的圆周内外两侧沿一圈射线稀疏采样, 按高度判断每个采样是否在圆周所在的高度,
+// 与"圆内/圆外"的预期一致的比例与上次完整检测时相当即认为预测仍成立, 跳过霍夫检测与 RANSAC
+class PoseTracker
+{
+public:
+    struct Params
+    {
+        double accel_noise = 0.01;          // 平移加速度噪声谱密度 ((m/s^2)^2·s)
+        double rot_noise = 0.05;            // 姿态随机游走 (rad^2/s)
+        double init_velocity_sigma = 0.1;   // 初始化时速度的标准差(米/秒)
+        double min_position_sigma = 0.0005; // 量测位置标准差下限(米)
+        double min_rotation_sigma = 0.005;  // 量测姿态标准差下限(弧度)
+        double gate = 16.27;                // 新息马氏距离平方门限(3自由度, 99.9%)
+        int max_rejects = 3;                // 连续拒绝超过该次数时重新初始化
+        double max_gap = 1.0;               // 两帧间隔超过该值(秒)时重新初始化
+
+        // 仅验证
+        bool verify = true;
+        int verify_rays = 64;            // 采样方向数, 每个方向圆内外各3个采样
+        float verify_band = 0.01f;       // 采样到圆周的最大平面内距离(米)
+        float verify_gap = 0.0015f;      // 到圆周小于该距离的采样不计, 边缘处无法区分内外
+        float verify_ratio = 0.9f;       // 一致比例不低于参考值的该倍数时验证通过
+        int min_verify_samples = 20;     // 参考帧上圆内或圆外的有效采样少于该值时不验证
+        int max_verified = 10;           // 连续验证的帧数上限, 达到后做一次完整检测
+        double max_verify_sigma = 0.005; // 预测位置标准差超过该值(米)时不验证
+    };
+
+    // 圆周两侧采样的统计, level 为与圆心等高(比平面更接近圆心高度)的采样数
+    struct SampleStats
+    {
+        int inside = 0;
+        int inside_level = 0;
+        int outside = 0;
+        int outside_level = 0;
+
+        int valid() const { return inside + outside; }
+    };
+
+    PoseTracker() : PoseTracker(Params()) {}
+    explicit PoseTracker(const Params &params) : params_(params) {}
+
+    // 以完整检测的结果更新, t 为帧时间(秒), covariance 为量测协方差(6x6 行优先);
+    // 首帧直接初始化, 被门限拒绝时返回 false
+    bool update(double t, const Eigen::Vector3d &position, const Eigen::Matrix3d &rotation, const double *covariance);
+
+    // 验证通过的帧: 状态推进到 t, 不做量测更新
+    void coast(double t);
+
+    // 预测 t 时刻的位姿, 不改变状态; 未初始化时返回 false
+    bool predict(double t, Eigen::Vector3d &position, Eigen::Matrix3d &rotation, double *covariance = nullptr) const;
+
+    // 当前估计, covariance 可为空
+    void getPose(Eigen::Vector3d &position, Eigen::Matrix3d &rotation, double *covariance = nullptr) const;
+
+    // t 时刻是否可以只验证: 已初始化, 有参考统计, 连续验证帧数与预测标准差均未超限
+    bool canVerify(double t) const;
+
+    // 记录加油口模型(圆半径, 圆心在平面之上的高度), 并以 position/rotation 在本帧上采样得到验证参考
+    template <typename PointT>
+    void calibrate(const pcl::PointCloud<PointT> &cloud, const Pinhole &camera, const Eigen::Vector3d &position,
+                   const Eigen::Matrix3d &rotation, float radius, float height);
+
+    // 用预测的位姿在新的一帧上采样, 局内点比例与参考相当时返回 true
+    template <typename PointT>
+    bool verify(const pcl::PointCloud<PointT> &cloud, const Pinhole &camera, const Eigen::Vector3d &position,
+                const Eigen::Matrix3d &rotation) const;
+
+    // 预测位姿下加油口在图像中的圆心与半径(像素)
+    bool projectRim(const Pinhole &camera, const Eigen::Vector3d &position, cv::Point2f &center, float &radius) const;
+
+    bool isTracking() const { return initialized_; }
+
+    void reset()
+    {
+        initialized_ = false;
+        has_reference_ = false;
+    }
+
+    Params &params() { return params_; }
+
+private:
+    typedef Eigen::Matrix<double, 6, 1> Vector6d;
+    typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+
+    void initialize(double t, const Eigen::Vector3d &position, const Eigen::Matrix3d &rotation,
+                    const Eigen::Matrix3d &position_cov, const Eigen::Matrix3d &rotation_cov);
+
+    // 平移状态与两个协方差推进 dt 秒
+    void propagate(double dt, Vector6d &x, Matrix6d &P, Eigen::Matrix3d &P_rot) const;
+
+    // 与参考帧的内外高度模式一致的采样数
+    int agreement(const SampleStats &stats) const
+    {
+        return (inside_level_ ? stats.inside_level : stats.inside - stats.inside_level) +
+               (outside_level_ ? stats.outside_level : stats.outside - stats.outside_level);
+    }
+
+    template <typename PointT>
+    SampleStats sample(const pcl::PointCloud<PointT> &cloud, const Pinhole &camera, const Eigen::Vector3d &position,
+                       const Eigen::Matrix3d &rotation) const;
+
+private:
+    Params params_;
+
+    bool initialized_ = false;
+    double t_ = 0;
+    int rejects_ = 0;  // 连续被拒绝的量测数
+    int verified_ = 0; // 连续验证通过的帧数
+
+    Vector6d x_;           // 位置, 速度
+    Matrix6d P_;
+    Eigen::Matrix3d rot_;   // 姿态, 误差定义为相机坐标系下的左扰动 R = exp(δ) R_est
+    Eigen::Matrix3d P_rot_;
+
+    // 加油口模型与验证参考
+    float radius_ = 0;
+    float height_ = 0;
+    bool has_reference_ = false;
+    bool inside_level_ = false, outside_level_ = false; // 参考帧上圆内/圆外是否与圆心等高
+    SampleStats reference_;
+    float reference_agreement_ = 0;
+};
+
+template <typename PointT>
+PoseTracker::SampleStats PoseTracker::sample(const pcl::PointCloud<PointT> &cloud, const Pinhole &camera,
+                                             const Eigen::Vector3d &position, const Eigen::Matrix3d &rotation) const
+{
+    SampleStats stats;
+    if (cloud.height <= 1 || !camera.valid() || radius_ <= 0)
+    {
+        return stats; // 需要有组织点云
+    }
+
+    const Eigen::Vector3f c = position.cast<float>();
+    const Eigen::Vector3f e1 = rotation.col(0).cast<float>(), e2 = rotation.col(1).cast<float>(), n = rotation.col(2).cast<float>();
+    const float offsets[6] = {-1.0f, -2.0f / 3, -1.0f / 3, 1.0f / 3, 2.0f / 3, 1.0f};
+    const int rays = std::max(params_.verify_rays, 1);
+    for (int k = 0; k < rays; k++)
+    {
+        const float angle = 2 * (float)M_PI * k / rays;
+        const Eigen::Vector3f dir = std::cos(angle) * e1 + std::sin(angle) * e2;
+        for (const float offset : offsets)
+        {
+            // 圆心高度上的采样点投影到图像, 取该像素的实测点
+            const Eigen::Vector3f target = c + (radius_ + offset * params_.verify_band) * dir;
+            if (target[2] <= 0)
+            {
+                continue;
+            }
+            const int col = (int)std::lround(camera.fx * target[0] / target[2] + camera.cx);
+            const int row = (int)std::lround(camera.fy * target[1] / target[2] + camera.cy);
+            if (col < 0 || row < 0 || col >= (int)cloud.width || row >= (int)cloud.height)
+            {
+                continue;
+            }
+            const PointT &p = cloud.points[row * cloud.width + col];
+            if (!std::isfinite(p.z) || p.z <= 0)
+            {
+                continue;
+            }
+
+            // 按实测点自身的平面内半径区分圆内外, 高度比平面更接近圆心时记为等高
+            const Eigen::Vector3f q = Eigen::Vector3f(p.x, p.y, p.z) - c;
+            const float h = q.dot(n), u = q.dot(e1), v = q.dot(e2);
+            const float d = std::sqrt(u * u + v * v) - radius_;
+            if (std::abs(d) < params_.verify_gap || std::abs(d) > params_.verify_band * 1.5f)
+            {
+                continue;
+            }
+            const bool level = std::abs(h) < std::abs(h + height_);
+            if (d < 0)
+            {
+                stats.inside++;
+                stats.inside_level += level;
+            }
+            else
+            {
+                stats.outside++;
+                stats.outside_level += level;
+            }
+        }
+    }
+    return stats;
+}
+
+template <typename PointT>
+void PoseTracker::calibrate(const pcl::PointCloud<PointT> &cloud, const Pinhole &camera, const Eigen::Vector3d &position,
+                            const Eigen::Matrix3d &rotation, float radius, float height)
+{
+    radius_ = radius;
+    height_ = height;
+    reference_ = sample(cloud, camera, position, rotation);
+
+    // 圆周两侧需有高度台阶才能验证
+    inside_level_ = reference_.inside_level * 2 > reference_.inside;
+    outside_level_ = reference_.outside_level * 2 > reference_.outside;
+    has_reference_ = inside_level_ != outside_level_ && reference_.inside >= params_.min_verify_samples &&
+                     reference_.outside >= params_.min_verify_samples;
+    reference_agreement_ = has_reference_ ? (float)agreement(reference_) / reference_.valid() : 0;
+}
+
+template <typename PointT>
+bool PoseTracker::verify(const pcl::PointCloud<PointT> &cloud, const Pinhole &camera, const Eigen::Vector3d &position,
+                         const Eigen::Matrix3d &rotation) const
+{
+    if (!has_reference_)
+    {
+        return false;
+    }
+    const SampleStats stats = sample(cloud, camera, position, rotation);
+    if (stats.valid() * 2 < reference_.valid() || stats.inside == 0 || stats.outside == 0)
+    {
+        return false; // 有效采样明显变少(遮挡或移出视野)
+    }
+    return agreement(stats) >= params_.verify_ratio * reference_agreement_ * stats.valid();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+// 基于哈希表的体素降采样, 替代 pcl::VoxelGrid:
+// - 体素坐标按每轴21位打包为64位键, 不受 VoxelGrid 整数索引范围限制, 也不需要排序
+// - 键计算并行; 哈希表按键分区, 各线程只插入自己分区的键
+// - 输出按每个体素第一个点在输入中的顺序排列, 与线程数无关
+// - 输入点已位于与坐标轴对齐、间距为体素整数倍的格点上时(如 TSDF 体素中心), 不做任何处理
+class VoxelDownsample
+{
+public:
+    enum class Policy
+    {
+        Centroid, // 体素内点的均值, 与 VoxelGrid 一致
+        First     // 体素内在输入中最先出现的点
+    };
+
+    struct Params
+    {
+        float leaf_size = 0.0005f;
+        Policy policy = Policy::Centroid;
+        float lattice_tolerance = 1e-3f; // 格点检测时允许的偏差(体素尺寸的比例)
+        int lattice_samples = 1024;      // 格点检测的采样点数
+    };
+
+    VoxelDownsample() : VoxelDownsample(Params()) {}
+    explicit VoxelDownsample(const Params &params) : params_(params) {}
+
+    // 返回 false 表示输入已在格点上, 未写入 output(调用方可直接使用输入)
+    bool filter(const pcl::PointCloud<pcl::PointXYZ> &input, pcl::PointCloud<pcl::PointXYZ> &output);
+
+    // 抽样检查输入点是否都位于间距为 leaf_size 的轴对齐格点上
+    bool isLatticeAligned(const pcl::PointCloud<pcl::PointXYZ> &input) const;
+
+    Params &params() { return params_; }
+
+private:
+    static const uint64_t kInvalidKey = ~0ULL;
+
+    Params params_;
+
+    // 以下缓存在多次调用间复用
+    std::vector<uint64_t> keys_;       // 每个输入点的体素键
+    std::vector<int> slot_;            // 每个输入点所在的哈希表槽位
+
+    // 哈希表槽位, 一次探测只访问一个缓存行
+    struct Slot
+    {
+        uint64_t key;
+        int first; // 体素内第一个点的下标
+        int count;
+        float sum[3];
+    };
+    std::vector<Slot> table_;
+};
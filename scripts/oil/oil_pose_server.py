@@ -58,14 +58,19 @@ class OilPoseReconstructServer(object):
         self.client_ = rospy.ServiceProxy(service_name, OilPoseDetector)
 
     def find(self, flag):
+        (is_find, position, orientation, _, _) = self.findWithCovariance(flag)
+        return (is_find, position, orientation)
+
+    # 同 find, 另返回位置标准差(米)与6x6位姿协方差(行优先), 标准差足够小时调用方可跳过重新扫描
+    def findWithCovariance(self, flag):
         is_find = True
         position = [0, 0, 0]
         orientation = [0, 0, 0, 1]
 
-        position, orientation = self.clientCall(flag)
+        position, orientation, position_sigma, covariance = self.clientCall(flag)
 
         print((position, orientation))
-        return (is_find, position, orientation)
+        return (is_find, position, orientation, position_sigma, covariance)
 
     def clientCall(self, flag):
         print("---------- client ---------")
@@ -76,5 +81,6 @@ class OilPoseReconstructServer(object):
         response = OilPoseDetectorResponse()
 
         response = self.client_.call(request)
+        print("position_sigma: %f" % response.position_sigma)
 
-        return response.trans, response.quat
+        return response.trans, response.quat, response.position_sigma, response.covariance
@@ -24,6 +24,20 @@ int main(int argc, char **argv)
     std::string topicDepth;
     bool useExact = false;
     bool useCompressed = false;
+    std::string framePolicy;
+    int frameQueueSize = 3;
+    int detectLevel = 0;
+    int refineInterval = 0;
+    std::string pyramidMode;
+    bool hostAlign = false;
+    bool tracking = true;
+    bool halfResolution = false;
+    double maxPositionSigma = 0.005;
+    bool pipeline = true;
+    bool verifyOnly = true;
+    bool organizedPlane = true;
+    int showRate = 10;
+    int showStep = 2;
 
     node.param("show", show, true);
     node.param("camera", camera, std::string("realsense"));
@@ -32,6 +46,20 @@ int main(int argc, char **argv)
     node.param("topicDepth", topicDepth, std::string("/camera/depth/image_raw"));
     node.param("useExact", useExact, false);
     node.param("useCompressed", useCompressed, false);
+    node.param("framePolicy", framePolicy, std::string("latest")); // latest: 只处理最新帧, queue: 有界队列
+    node.param("frameQueueSize", frameQueueSize, 3);
+    node.param("detectLevel", detectLevel, 0);       // 0: 原始分辨率, 1: 1/2, 2: 1/4
+    node.param("refineInterval", refineInterval, 0); // detectLevel>0 时每隔多少帧用原始分辨率精检
+    node.param("pyramidMode", pyramidMode, std::string("min")); // stride, min, median
+    node.param("tracking", tracking, true);    // 在上一帧加油口附近窗口内检测, 丢失时整帧检测
+    node.param("halfResolution", halfResolution, false); // 整帧圆检测在1/2分辨率灰度图上进行
+    node.param("maxPositionSigma", maxPositionSigma, 0.005); // 单帧位置标准差门限(米), 超过时丢弃该帧
+    node.param("pipeline", pipeline, true); // 不显示时采集/2D检测/3D拟合/发布分级并行
+    node.param("verifyOnly", verifyOnly, true); // 跟踪稳定时只验证预测的位姿, 跳过完整检测
+    node.param("organizedPlane", organizedPlane, true); // 平面与圆孔边缘在有组织点云上提取, 失败时回退到 RANSAC
+    node.param("showRate", showRate, 10); // 显示线程刷新频率, 与检测频率无关
+    node.param("showStep", showStep, 2);  // 点云显示的抽稀步长
+    node.param("hostAlign", hostAlign, false); // tuyang: topicDepth 为原始深度图, 由主机配准到彩色图像
 
     if (!ros::ok())
     {
@@ -43,11 +71,33 @@ int main(int argc, char **argv)
     /// Realsense cloud and image receiver
     std::shared_ptr<CameraReceiver> camera_receiver;
     if (camera == "tuyang")
-        camera_receiver = std::make_shared<TuYangCameraReceiver>(node, topicColor, topicDepth, useExact, useCompressed, loop_rate);
+    {
+        auto tuyang_receiver = std::make_shared<TuYangCameraReceiver>(node, topicColor, topicDepth, useExact, useCompressed, loop_rate);
+        tuyang_receiver->setHostAlign(hostAlign);
+        camera_receiver = tuyang_receiver;
+    }
     else
         camera_receiver = std::make_shared<CameraReceiver>(node, topicColor, topicDepth, useExact, useCompressed, loop_rate);
+    if (framePolicy == "queue")
+        camera_receiver->setFramePolicy(FramePolicy::BoundedQueue, frameQueueSize);
 
     OilFillerPose of_pose(node, camera_receiver, oil_frame_reference, loop_rate);
+    of_pose.setTracking(tracking);
+    of_pose.setHalfResolution(halfResolution);
+    of_pose.setMaxPositionSigma(maxPositionSigma);
+    of_pose.setPipeline(pipeline);
+    of_pose.setVerifyOnly(verifyOnly);
+    of_pose.setOrganizedPlane(organizedPlane);
+    of_pose.setShowRate(showRate, showStep);
+    if (detectLevel > 0)
+    {
+        PyramidMode mode = PyramidMode::MinPool;
+        if (pyramidMode == "stride")
+            mode = PyramidMode::Stride;
+        else if (pyramidMode == "median")
+            mode = PyramidMode::MedianPool;
+        of_pose.setDetectLevel(detectLevel, refineInterval, mode);
+    }
     if (!show)
     {
         of_pose.run(loop_rate);
@@ -136,6 +136,8 @@ void SimpleFusion::simpleFusion_(std::string data_folder, int frame_nums, const
     }
 
     // Compute surface points from TSDF voxel grid and save to point cloud .ply file
+    if (ply_save_path.empty())
+        return;
     std::cout << "Saving surface point cloud : " << ply_save_path << std::endl;
     pcl::PLYWriter writer;
     writer.write(ply_save_path, *pointcloud, true);
@@ -3,12 +3,14 @@
 // ---------------------------------------------------------
 #include "fusion/tsdf_cuda.cuh"
 #include "fusion/utils.h"
+#include "fusion/tsdf_volume.h"
 
 #include <iostream>
 #include <fstream>
 #include <iomanip>
 #include <sstream>
 #include <string>
+#include <algorithm>
 
 void FatalError(const int lineNumber = 0)
 {
@@ -86,8 +88,9 @@ void Integrate(float * cam_K, float * cam2base, float * depth_im,
 
 // Loads a binary file with depth data and generates a TSDF voxel volume (5m x 5m x 5m at 1cm resolution)
 // Volume is aligned with respect to the camera coordinates of the first frame (a.k.a. base frame)
-extern "C" void TSDF_Fusion(const char * data_folder, int frame_nums, const float*target_pos, const char *save_path) {
-    std::string ply_save_path = save_path;  // 重建的ply文件保存位置
+extern "C" void TSDF_Fusion(const char * data_folder, int frame_nums, const float*target_pos, const char *save_path,
+                            TsdfVolume *volume) {
+    std::string ply_save_path = save_path ? save_path : "";  // 重建的ply文件保存位置, 为空时不导出
     std::string data_path = data_folder;
     std::string reconstruct_data_folder = data_path + "/reconstruct_data";  // 重建需要的数据(相机位姿、深度图)
     std::string base2world_file = data_path + "/rough_detecter" +"/frame_0_camerapose.txt";
@@ -165,13 +168,23 @@ extern "C" void TSDF_Fusion(const char * data_folder, int frame_nums, const floa
     std::cout <<"voxel_grid_origin(move to origin): " <<std::endl;
     std::cout <<voxel_grid_origin_x <<","<<voxel_grid_origin_y <<","<<voxel_grid_origin_z <<"\n";
 
-    // Initialize voxel grid
+    // Initialize voxel grid, 主机端体素由调用方的 volume 持有(未传入时为局部变量)
     std::cout << "Initialize voxel grid\n";
-    float * voxel_grid_TSDF = new float[voxel_grid_dim_x * voxel_grid_dim_y * voxel_grid_dim_z];
-    float * voxel_grid_weight = new float[voxel_grid_dim_x * voxel_grid_dim_y * voxel_grid_dim_z];
-    for (int i = 0; i < voxel_grid_dim_x * voxel_grid_dim_y * voxel_grid_dim_z; ++i)
-        voxel_grid_TSDF[i] = 1.0f;
-    memset(voxel_grid_weight, 0, sizeof(float) * voxel_grid_dim_x * voxel_grid_dim_y * voxel_grid_dim_z);
+    TsdfVolume local_volume;
+    TsdfVolume &host_volume = volume ? *volume : local_volume;
+    host_volume.dim_x = voxel_grid_dim_x;
+    host_volume.dim_y = voxel_grid_dim_y;
+    host_volume.dim_z = voxel_grid_dim_z;
+    host_volume.voxel_size = voxel_size;
+    host_volume.trunc_margin = trunc_margin;
+    host_volume.origin[0] = voxel_grid_origin_x;
+    host_volume.origin[1] = voxel_grid_origin_y;
+    host_volume.origin[2] = voxel_grid_origin_z;
+    std::copy(base2world, base2world + 16, host_volume.base2world);
+    host_volume.tsdf.assign(voxel_grid_dim_x * voxel_grid_dim_y * voxel_grid_dim_z, 1.0f);
+    host_volume.weight.assign(voxel_grid_dim_x * voxel_grid_dim_y * voxel_grid_dim_z, 0.0f);
+    float * voxel_grid_TSDF = host_volume.tsdf.data();
+    float * voxel_grid_weight = host_volume.weight.data();
 
     // Load variables to GPU memory
     float * gpu_voxel_grid_TSDF;
@@ -236,10 +249,12 @@ extern "C" void TSDF_Fusion(const char * data_folder, int frame_nums, const floa
     cudaFree(gpu_depth_im);
 
     // Compute surface points from TSDF voxel grid and save to point cloud .ply file
-    std::cout << "Saving surface point cloud : " << ply_save_path << std::endl;
-    SaveVoxelGrid2SurfacePointCloud(ply_save_path, voxel_grid_dim_x, voxel_grid_dim_y, voxel_grid_dim_z, 
-                                    voxel_size, voxel_grid_origin_x, voxel_grid_origin_y, voxel_grid_origin_z,
-                                    voxel_grid_TSDF, voxel_grid_weight, 0.2f, 0.0f, base2world);
+    if (!ply_save_path.empty()) {
+        std::cout << "Saving surface point cloud : " << ply_save_path << std::endl;
+        SaveVoxelGrid2SurfacePointCloud(ply_save_path, voxel_grid_dim_x, voxel_grid_dim_y, voxel_grid_dim_z, 
+                                        voxel_size, voxel_grid_origin_x, voxel_grid_origin_y, voxel_grid_origin_z,
+                                        voxel_grid_TSDF, voxel_grid_weight, 0.2f, 0.0f, base2world);
+    }
 }
 
 
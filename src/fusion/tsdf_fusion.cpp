@@ -10,6 +10,6 @@ TsdfFusion::~TsdfFusion()
 void TsdfFusion::fusion(std::string img_folder, int num, const float *target_pos, std::string save_ply_path)
 {
     std::cout << "[TsdfFusion] tsdf fusion start ...." << std::endl;
-    TSDF_Fusion(img_folder.c_str(), num, target_pos, save_ply_path.c_str());
+    TSDF_Fusion(img_folder.c_str(), num, target_pos, save_ply_path.c_str(), &volume_);
     std::cout << "[TsdfFusion] tsdf fusion complete" << std::endl;
 }
\ No newline at end of file
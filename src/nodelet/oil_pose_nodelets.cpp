@@ -0,0 +1,151 @@
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <ros/callback_queue.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include "oil_detect/oil_detect.h"
+#include "oil_detect/oil_reconstruct_server.h"
+#include "camera/tuyang_receiver.h"
+
+namespace oil_pose_detector
+{
+
+// 与 detect_oil_pose 相同的单帧检测, 以nodelet形式加载到相机驱动的管理器中,
+// 彩色/深度/CameraInfo 以 ConstPtr 进程内传递, 无序列化与TCPROS拷贝
+class OilPoseNodelet : public nodelet::Nodelet
+{
+public:
+    // 卸载时先停止检测循环(或首帧等待)并等待工作线程退出, 之后才析构其使用的成员
+    ~OilPoseNodelet() override
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            stopping_ = true;
+            if (of_pose_)
+                of_pose_->stop();
+        }
+        if (worker_.joinable())
+            worker_.join();
+    }
+
+private:
+    void onInit() override
+    {
+        ros::NodeHandle &pnh = getMTPrivateNodeHandle();
+
+        bool show;
+        std::string camera;
+        std::string oil_frame_reference;
+        std::string topicColor;
+        std::string topicDepth;
+        bool useExact = false;
+        bool useCompressed = false;
+        bool hostAlign = false;
+        int loop_rate = 15;
+        double maxPositionSigma = 0.005;
+        bool pipeline = true;
+        bool verifyOnly = true;
+        bool organizedPlane = true;
+        int showRate = 10;
+        int showStep = 2;
+
+        pnh.param("show", show, false);
+        pnh.param("camera", camera, std::string("realsense"));
+        pnh.param("oil_frame_reference", oil_frame_reference, std::string("camera_color_optical_frame"));
+        pnh.param("topicColor", topicColor, std::string("/camera/color/image_raw"));
+        pnh.param("topicDepth", topicDepth, std::string("/camera/depth/image_raw"));
+        pnh.param("useExact", useExact, false);
+        pnh.param("useCompressed", useCompressed, false);
+        pnh.param("hostAlign", hostAlign, false);
+        pnh.param("loop_rate", loop_rate, 15);
+        pnh.param("maxPositionSigma", maxPositionSigma, 0.005);
+        pnh.param("pipeline", pipeline, true);
+        pnh.param("verifyOnly", verifyOnly, true);
+        pnh.param("organizedPlane", organizedPlane, true);
+        pnh.param("showRate", showRate, 10);
+        pnh.param("showStep", showStep, 2);
+
+        if (camera == "tuyang")
+        {
+            auto tuyang_receiver = std::make_shared<TuYangCameraReceiver>(pnh, topicColor, topicDepth, useExact, useCompressed, loop_rate);
+            tuyang_receiver->setHostAlign(hostAlign);
+            receiver_ = tuyang_receiver;
+        }
+        else
+            receiver_ = std::make_shared<CameraReceiver>(pnh, topicColor, topicDepth, useExact, useCompressed, loop_rate);
+        receiver_->setExternalSpin(true); // 图像回调由nodelet管理器spin
+        receiver_->setStopFlag(&stopping_);
+
+        // OilFillerPose 构造时会等待首帧, 不能阻塞 onInit; 其发布者等回调在本nodelet自己的队列中由检测循环处理,
+        // 不在管理器进程内 spin 全局队列
+        worker_ = std::thread([this, show, oil_frame_reference, loop_rate, maxPositionSigma, pipeline, verifyOnly, organizedPlane, showRate,
+                              showStep]() {
+            ros::NodeHandle nh(getMTPrivateNodeHandle());
+            nh.setCallbackQueue(&queue_);
+            std::unique_ptr<OilFillerPose> of_pose(new OilFillerPose(nh, receiver_, oil_frame_reference, loop_rate));
+            of_pose->setCallbackQueue(&queue_);
+            of_pose->setMaxPositionSigma(maxPositionSigma);
+            of_pose->setPipeline(pipeline);
+            of_pose->setVerifyOnly(verifyOnly);
+            of_pose->setOrganizedPlane(organizedPlane);
+            of_pose->setShowRate(showRate, showStep);
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+                if (stopping_)
+                {
+                    receiver_->stop(); // 未收到首帧即卸载
+                    return;
+                }
+                of_pose_ = std::move(of_pose);
+            }
+            if (show)
+                of_pose_->runShow(loop_rate);
+            else
+                of_pose_->run(loop_rate);
+        });
+        NODELET_INFO("OilPoseNodelet started.");
+    }
+
+    // 析构顺序与声明相反: 工作线程最先结束, 接收器最后释放
+    std::shared_ptr<CameraReceiver> receiver_;
+    ros::CallbackQueue queue_;
+    std::unique_ptr<OilFillerPose> of_pose_;
+    std::mutex lock_;
+    std::atomic<bool> stopping_{false};
+    std::thread worker_;
+};
+
+// 与 detect_oil_with_reconstruct 相同的三维重建检测服务
+class OilReconstructNodelet : public nodelet::Nodelet
+{
+public:
+    ~OilReconstructNodelet() override
+    {
+        stopping_ = true;
+        if (worker_.joinable())
+            worker_.join();
+    }
+
+private:
+    void onInit() override
+    {
+        // 服务构造时会等待首帧, 卸载时由 stopping_ 中断等待
+        worker_ = std::thread([this]() {
+            server_.reset(new DetectOilWithReconstructServer("get_pose", getMTPrivateNodeHandle(), true, &stopping_));
+        });
+        NODELET_INFO("OilReconstructNodelet started.");
+    }
+
+    std::unique_ptr<DetectOilWithReconstructServer> server_;
+    std::atomic<bool> stopping_{false};
+    std::thread worker_;
+};
+
+} // namespace oil_pose_detector
+
+PLUGINLIB_EXPORT_CLASS(oil_pose_detector::OilPoseNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(oil_pose_detector::OilReconstructNodelet, nodelet::Nodelet)
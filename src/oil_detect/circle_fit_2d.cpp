@@ -0,0 +1,307 @@
+#include "oil_detect/circle_fit_2d.h"
+
+#include <random>
+#include <limits>
+#include <algorithm>
+
+bool CircleFit2D::fit(pcl::PointIndices &inliers, pcl::ModelCoefficients &coefficients)
+{
+    inliers.indices.clear();
+    coefficients.values.clear();
+    iterations_ = 0;
+    quality_ = Quality();
+
+    const int n = (int)u_.size();
+    if (n < 3)
+    {
+        return false;
+    }
+
+    std::mt19937 rng(params_.seed);
+    float best_u = 0, best_v = 0, best_r = 0;
+    int best_score = 0;
+    int needed = params_.max_iterations;
+
+    for (; iterations_ < needed; iterations_++)
+    {
+        const int i0 = rng() % n, i1 = rng() % n, i2 = rng() % n;
+        if (i0 == i1 || i0 == i2 || i1 == i2)
+        {
+            continue;
+        }
+
+        // 三点外接圆
+        const float su[3] = {u_[i0], u_[i1], u_[i2]};
+        const float sv[3] = {v_[i0], v_[i1], v_[i2]};
+        float cu, cv, r;
+        if (!fitKasa(su, sv, 3, cu, cv, r) || !radiusValid(r))
+        {
+            continue;
+        }
+
+        int score = countInliers(cu, cv, r);
+        if (score <= best_score)
+        {
+            continue;
+        }
+
+        // 局部优化: 用局内点重新拟合, 直到局内点不再增加
+        for (int k = 0; k < params_.lo_iterations; k++)
+        {
+            float ru = cu, rv = cv, rr = r;
+            if (!refine(ru, rv, rr) || !radiusValid(rr))
+            {
+                break;
+            }
+            const int refined = countInliers(ru, rv, rr);
+            if (refined <= score)
+            {
+                break;
+            }
+            cu = ru, cv = rv, r = rr, score = refined;
+        }
+
+        best_u = cu, best_v = cv, best_r = r, best_score = score;
+
+        // k = log(1-p) / log(1-w^3)
+        const double w = (double)best_score / n;
+        const double p_fail = 1.0 - w * w * w;
+        if (p_fail <= std::numeric_limits<double>::epsilon())
+        {
+            break;
+        }
+        needed = (int)std::min<double>(needed, std::ceil(std::log(1.0 - params_.probability) / std::log(p_fail)));
+    }
+
+    if (best_score < 3)
+    {
+        return false;
+    }
+
+    // 用最终局内点再做一次 Taubin 拟合; 局内点不增加时局部优化不会替换三点假设, 圆心仍带采样噪声
+    {
+        float ru = best_u, rv = best_v, rr = best_r;
+        if (refine(ru, rv, rr) && radiusValid(rr))
+        {
+            best_u = ru, best_v = rv, best_r = rr;
+        }
+    }
+
+    // 局内点与圆心高度; 同时累计残差与 (cu, cv, r) 的雅可比 J^T J, 用于质量估计
+    const float thr = params_.distance_threshold;
+    heights_.clear();
+    inliers.indices.reserve(best_score);
+    Eigen::Matrix3d jtj = Eigen::Matrix3d::Zero();
+    double sum_res2 = 0, sum_h = 0, sum_h2 = 0;
+    for (int i = 0; i < n; i++)
+    {
+        const float du = u_[i] - best_u, dv = v_[i] - best_v;
+        const float d = std::sqrt(du * du + dv * dv);
+        const float res = d - best_r;
+        if (std::abs(res) <= thr && d > 0)
+        {
+            inliers.indices.push_back(index_[i]);
+            heights_.push_back(h_[i]);
+            const Eigen::Vector3d j(du / d, dv / d, 1.0);
+            jtj += j * j.transpose();
+            sum_res2 += res * res;
+            sum_h += h_[i];
+            sum_h2 += h_[i] * h_[i];
+        }
+    }
+    auto mid = heights_.begin() + heights_.size() / 2;
+    std::nth_element(heights_.begin(), mid, heights_.end());
+
+    const Eigen::Vector3f center = origin_ + best_u * e1_ + best_v * e2_ + *mid * normal_;
+    coefficients.values = {center[0], center[1], center[2], best_r, normal_[0], normal_[1], normal_[2]};
+
+    // 圆参数协方差 σ²(J^T J)^-1; 高度取中值, 方差约为 (π/2)·var(h)/N
+    const double count = heights_.size();
+    const double var = sum_res2 / std::max(count - 3, 1.0);
+    quality_.inliers = (int)count;
+    quality_.rms = (float)std::sqrt(sum_res2 / count);
+    const Eigen::FullPivLU<Eigen::Matrix3d> lu(jtj);
+    if (lu.isInvertible())
+    {
+        const Eigen::Matrix3d cov = var * lu.inverse();
+        const double mean_h = sum_h / count;
+        const double var_h = std::max(sum_h2 / count - mean_h * mean_h, 0.0) * M_PI / 2 / count;
+        Eigen::Matrix3d basis;
+        basis << e1_.cast<double>(), e2_.cast<double>(), normal_.cast<double>();
+        Eigen::Matrix3d local = Eigen::Matrix3d::Zero();
+        local.topLeftCorner<2, 2>() = cov.topLeftCorner<2, 2>();
+        local(2, 2) = var_h;
+        quality_.center_covariance = basis * local * basis.transpose();
+        quality_.radius_variance = cov(2, 2);
+    }
+    else
+    {
+        // 局内点共线/过少, 圆心不可观测
+        quality_.center_covariance = Eigen::Matrix3d::Identity() * thr * thr;
+        quality_.radius_variance = thr * thr;
+    }
+    return true;
+}
+
+int CircleFit2D::countInliers(float cu, float cv, float r) const
+{
+    // |d - r| <= t  <=>  (r-t)^2 <= d^2 <= (r+t)^2, 避免开方
+    const float thr = params_.distance_threshold;
+    const float r_in = std::max(r - thr, 0.0f), r_out = r + thr;
+    const float lo = r_in * r_in, hi = r_out * r_out;
+    const float *u = u_.data(), *v = v_.data();
+    const int n = (int)u_.size();
+
+    int count = 0;
+#pragma omp simd reduction(+ : count)
+    for (int i = 0; i < n; i++)
+    {
+        const float du = u[i] - cu, dv = v[i] - cv;
+        const float d2 = du * du + dv * dv;
+        count += (d2 >= lo && d2 <= hi) ? 1 : 0;
+    }
+    return count;
+}
+
+bool CircleFit2D::refine(float &cu, float &cv, float &r)
+{
+    const float thr = params_.distance_threshold;
+    const float r_in = std::max(r - thr, 0.0f), r_out = r + thr;
+    const float lo = r_in * r_in, hi = r_out * r_out;
+
+    lo_u_.clear();
+    lo_v_.clear();
+    for (int i = 0; i < (int)u_.size(); i++)
+    {
+        const float du = u_[i] - cu, dv = v_[i] - cv;
+        const float d2 = du * du + dv * dv;
+        if (d2 >= lo && d2 <= hi)
+        {
+            lo_u_.push_back(u_[i]);
+            lo_v_.push_back(v_[i]);
+        }
+    }
+    return fitTaubin(lo_u_.data(), lo_v_.data(), (int)lo_u_.size(), cu, cv, r);
+}
+
+bool CircleFit2D::fitKasa(const float *u, const float *v, int n, float &cu, float &cv, float &r)
+{
+    if (n < 3)
+    {
+        return false;
+    }
+
+    // 最小二乘求解 u^2 + v^2 + D*u + E*v + F = 0, 坐标先去均值改善条件数
+    double mu = 0, mv = 0;
+    for (int i = 0; i < n; i++)
+    {
+        mu += u[i];
+        mv += v[i];
+    }
+    mu /= n;
+    mv /= n;
+
+    Eigen::Matrix3d A = Eigen::Matrix3d::Zero();
+    Eigen::Vector3d b = Eigen::Vector3d::Zero();
+    for (int i = 0; i < n; i++)
+    {
+        const double x = u[i] - mu, y = v[i] - mv, z = x * x + y * y;
+        const Eigen::Vector3d row(x, y, 1.0);
+        A += row * row.transpose();
+        b -= z * row;
+    }
+
+    const Eigen::FullPivLU<Eigen::Matrix3d> lu(A);
+    if (!lu.isInvertible())
+    {
+        return false; // 共线
+    }
+    const Eigen::Vector3d s = lu.solve(b);
+    const double x0 = -s[0] / 2, y0 = -s[1] / 2, r2 = x0 * x0 + y0 * y0 - s[2];
+    if (r2 <= 0)
+    {
+        return false;
+    }
+
+    cu = (float)(x0 + mu);
+    cv = (float)(y0 + mv);
+    r = (float)std::sqrt(r2);
+    return true;
+}
+
+bool CircleFit2D::fitTaubin(const float *u, const float *v, int n, float &cu, float &cv, float &r)
+{
+    if (n < 3)
+    {
+        return false;
+    }
+
+    double mu = 0, mv = 0;
+    for (int i = 0; i < n; i++)
+    {
+        mu += u[i];
+        mv += v[i];
+    }
+    mu /= n;
+    mv /= n;
+
+    // 去均值后的各阶矩
+    double Mxx = 0, Myy = 0, Mxy = 0, Mxz = 0, Myz = 0, Mzz = 0;
+    for (int i = 0; i < n; i++)
+    {
+        const double x = u[i] - mu, y = v[i] - mv, z = x * x + y * y;
+        Mxx += x * x;
+        Myy += y * y;
+        Mxy += x * y;
+        Mxz += x * z;
+        Myz += y * z;
+        Mzz += z * z;
+    }
+    Mxx /= n, Myy /= n, Mxy /= n, Mxz /= n, Myz /= n, Mzz /= n;
+
+    // 特征多项式系数, 牛顿法从0开始求最小根 (Chernov)
+    const double Mz = Mxx + Myy;
+    const double Cov_xy = Mxx * Myy - Mxy * Mxy;
+    const double Var_z = Mzz - Mz * Mz;
+    const double A3 = 4 * Mz;
+    const double A2 = -3 * Mz * Mz - Mzz;
+    const double A1 = Var_z * Mz + 4 * Cov_xy * Mz - Mxz * Mxz - Myz * Myz;
+    const double A0 = Mxz * (Mxz * Myy - Myz * Mxy) + Myz * (Myz * Mxx - Mxz * Mxy) - Var_z * Cov_xy;
+    const double A22 = A2 + A2, A33 = A3 + A3 + A3;
+
+    double x = 0, y = A0;
+    for (int iter = 0; iter < 20; iter++)
+    {
+        const double Dy = A1 + x * (A22 + A33 * x);
+        const double x_new = x - y / Dy;
+        if (x_new == x || !std::isfinite(x_new))
+        {
+            break;
+        }
+        const double y_new = A0 + x_new * (A1 + x_new * (A2 + x_new * A3));
+        if (std::abs(y_new) >= std::abs(y))
+        {
+            break;
+        }
+        x = x_new;
+        y = y_new;
+    }
+
+    const double det = x * x - x * Mz + Cov_xy;
+    if (std::abs(det) < std::numeric_limits<double>::min())
+    {
+        return false;
+    }
+    const double x0 = (Mxz * (Myy - x) - Myz * Mxy) / det / 2;
+    const double y0 = (Myz * (Mxx - x) - Mxz * Mxy) / det / 2;
+    const double r2 = x0 * x0 + y0 * y0 + Mz;
+    if (!std::isfinite(r2) || r2 <= 0)
+    {
+        return false;
+    }
+
+    cu = (float)(x0 + mu);
+    cv = (float)(y0 + mv);
+    r = (float)std::sqrt(r2);
+    return true;
+}
@@ -0,0 +1,324 @@
+#include "oil_detect/circle_tracker.h"
+
+#include <cmath>
+#include <algorithm>
+
+bool CircleTracker::detect(const cv::Mat &color, int scale, CircleDetection &result)
+{
+    if (params_.enable && has_track_ && detectInWindow(color, scale, result))
+    {
+        result.tracked = true;
+    }
+    else if (detectFullFrame(color, scale, result))
+    {
+        result.tracked = false;
+    }
+    else
+    {
+        has_track_ = false;
+        return false;
+    }
+
+    // 置信度足够时才作为下一帧的跟踪起点
+    accept(result, scale);
+    return true;
+}
+
+bool CircleTracker::detectCandidates(const cv::Mat &color, int scale, int k, std::vector<CircleDetection> &candidates)
+{
+    candidates.clear();
+    CircleDetection tracked;
+    if (params_.enable && has_track_ && detectInWindow(color, scale, tracked))
+    {
+        tracked.tracked = true;
+    }
+    else
+    {
+        tracked.radius = 0;
+    }
+
+    gray_ = preprocess(color, scale, params_.half_resolution, gray_buf_, blur_buf_, factor_);
+    if (depth_.empty() || fx_ <= 0 || depth_.size() != color.size() || !detectWithPrior(candidates))
+    {
+        // 盲搜时候选间距取最小半径, 避免返回大量同心的重复圆
+        voteFullFrame(params_.min_radius / scale, params_.max_radius / scale, std::max(params_.min_radius / scale, 1));
+        scoreCandidates(circles_, 0, candidates);
+    }
+
+    if (tracked.radius > 0)
+    {
+        // 去掉与跟踪结果重叠的整帧候选
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                        [&tracked](const CircleDetection &det) {
+                                            return cv::norm(det.center - tracked.center) < 0.5f * std::max(det.radius, tracked.radius);
+                                        }),
+                         candidates.end());
+        candidates.insert(candidates.begin(), tracked);
+    }
+    if ((int)candidates.size() > k)
+    {
+        candidates.resize(k);
+    }
+    return !candidates.empty();
+}
+
+bool CircleTracker::detectInWindow(const cv::Mat &color, int scale, CircleDetection &result)
+{
+    const cv::Point2f center = last_center_ * (1.0f / scale);
+    const float radius = last_radius_ / scale;
+    const int min_r = std::max((int)std::floor(radius * (1.0f - params_.radius_tolerance)), 3);
+    const int max_r = std::max((int)std::ceil(radius * (1.0f + params_.radius_tolerance)), min_r + 1);
+
+    const int half = (int)std::ceil(max_r + radius * params_.window_margin);
+    const cv::Rect window = cv::Rect(cvRound(center.x) - half, cvRound(center.y) - half, 2 * half, 2 * half) &
+                            cv::Rect(0, 0, color.cols, color.rows);
+    if (window.width < 2 * min_r || window.height < 2 * min_r)
+    {
+        return false;
+    }
+
+    int factor = 1;
+    const cv::Mat gray = preprocess(color(window), scale, false, win_gray_buf_, win_blur_buf_, factor);
+
+    // 窗口内只需要一个圆, 最小间距取窗口大小
+    voter_.params().canny_threshold = params_.canny_threshold;
+    voter_.params().acc_threshold = cvRound(params_.acc_threshold);
+    voter_.detect(gray, min_r, max_r, std::max(window.width, window.height), circles_);
+    if (circles_.empty())
+    {
+        return false;
+    }
+
+    result.center = cv::Point2f(circles_[0][0], circles_[0][1]);
+    result.radius = circles_[0][2];
+    result.confidence = edgeSupport(gray, result.center, result.radius);
+    result.score = result.confidence;
+    result.center += cv::Point2f(window.x, window.y);
+    return result.confidence >= params_.min_confidence;
+}
+
+bool CircleTracker::detectFullFrame(const cv::Mat &color, int scale, CircleDetection &result)
+{
+    gray_ = preprocess(color, scale, params_.half_resolution, gray_buf_, blur_buf_, factor_);
+
+    // 有深度先验时只搜索预测半径附近, 未检到再退回盲搜
+    if (!depth_.empty() && fx_ > 0 && depth_.size() == color.size() && detectWithPrior(prior_candidates_))
+    {
+        result = prior_candidates_.front();
+        std::cout << "[CircleTracker] 深度先验检测, 半径 " << result.radius << ", 得分 " << result.score << std::endl;
+        return true;
+    }
+
+    // 参数:      默认, 最小间距, canny上限, 阈值(越大越圆), 最小半径, 最大半径
+    voteFullFrame(params_.min_radius / scale, params_.max_radius / scale, 1);
+    if (circles_.empty())
+    {
+        return false;
+    }
+
+    // 查找最大圆
+    int max_r_index = 0;
+    for (int i = 1; i < circles_.size(); i++)
+    {
+        if (circles_[i][2] > circles_[max_r_index][2])
+        {
+            max_r_index = i;
+        }
+    }
+
+    result.confidence = edgeSupport(gray_, cv::Point2f(circles_[max_r_index][0], circles_[max_r_index][1]), circles_[max_r_index][2]);
+    result.center = cv::Point2f(circles_[max_r_index][0], circles_[max_r_index][1]) * (float)factor_;
+    result.radius = circles_[max_r_index][2] * factor_;
+    result.score = result.confidence;
+    std::cout << "[CircleTracker] 整帧检测, 最大圆半径是 " << result.radius << ", 置信度 " << result.confidence << std::endl;
+    return true;
+}
+
+bool CircleTracker::detectWithPrior(std::vector<CircleDetection> &candidates)
+{
+    const float z = medianDepth(depth_);
+    if (z <= 0)
+    {
+        return false;
+    }
+
+    // 针孔模型: 像素半径 = fx * R / z
+    const float r_pred = fx_ * params_.physical_radius / z;
+    const int min_r = std::max((int)std::floor(r_pred * (1.0f - params_.prior_tolerance)), 3);
+    const int max_r = std::max((int)std::ceil(r_pred * (1.0f + params_.prior_tolerance)), min_r + 1);
+
+    // 候选圆之间至少相距一个预测半径
+    voteFullFrame(min_r, max_r, std::max(r_pred, 1.0f));
+    scoreCandidates(circles_, r_pred, candidates);
+    return !candidates.empty();
+}
+
+void CircleTracker::voteFullFrame(int min_r, int max_r, float min_dist)
+{
+    // 降采样后单个圆的投票数约减半, 阈值同比例降低
+    const int f = factor_;
+    voter_.params().canny_threshold = params_.canny_threshold;
+    voter_.params().acc_threshold = std::max(cvRound(params_.acc_threshold / f), 1);
+    voter_.detect(gray_, std::max(min_r / f, 3), std::max(max_r / f, 4), std::max(min_dist / f, 1.0f), circles_);
+}
+
+void CircleTracker::scoreCandidates(const std::vector<cv::Vec3f> &circles, float r_pred, std::vector<CircleDetection> &candidates)
+{
+    // 候选评分: 与预测尺寸的一致性, 圆周内外的深度跳变, 圆周边缘支持
+    scored_.clear();
+    const int count = std::min<int>(circles.size(), params_.max_candidates);
+    for (int i = 0; i < count; i++)
+    {
+        CircleDetection det;
+        det.confidence = edgeSupport(gray_, cv::Point2f(circles[i][0], circles[i][1]), circles[i][2]);
+        det.center = cv::Point2f(circles[i][0], circles[i][1]) * (float)factor_;
+        det.radius = circles[i][2] * factor_;
+        det.score = det.confidence;
+        if (r_pred > 0)
+        {
+            const float size_score = std::max(0.0f, 1.0f - std::abs(det.radius - r_pred) / (params_.prior_tolerance * r_pred));
+            const float rim_score = rimDiscontinuity(det.center, det.radius);
+            det.score = 0.4f * size_score + 0.3f * rim_score + 0.3f * det.confidence;
+        }
+        scored_.push_back(det);
+    }
+    std::sort(scored_.begin(), scored_.end(),
+              [](const CircleDetection &a, const CircleDetection &b) { return a.score > b.score; });
+
+    candidates.clear();
+    for (const auto &det : scored_)
+    {
+        bool overlap = false;
+        for (const auto &kept : candidates)
+        {
+            overlap |= cv::norm(det.center - kept.center) < 0.5f * std::max(det.radius, kept.radius);
+        }
+        if (!overlap)
+        {
+            candidates.push_back(det);
+        }
+    }
+}
+
+float CircleTracker::medianDepth(const cv::Mat &depth)
+{
+    const int step = 4;
+    depth_samples_.clear();
+    for (int r = 0; r < depth.rows; r += step)
+    {
+        const uint16_t *itD = depth.ptr<uint16_t>(r);
+        for (int c = 0; c < depth.cols; c += step)
+        {
+            if (itD[c] != 0)
+            {
+                depth_samples_.push_back(itD[c]);
+            }
+        }
+    }
+    if (depth_samples_.empty())
+    {
+        return 0;
+    }
+
+    auto mid = depth_samples_.begin() + depth_samples_.size() / 2;
+    std::nth_element(depth_samples_.begin(), mid, depth_samples_.end());
+    return *mid / params_.depth_scale;
+}
+
+float CircleTracker::rimDiscontinuity(const cv::Point2f &center, float radius) const
+{
+    const int samples = 32;
+    const float min_step = params_.min_rim_step * params_.depth_scale;
+
+    int valid = 0, step = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        const float theta = 2.0f * (float)CV_PI * i / samples;
+        const float dx = std::cos(theta), dy = std::sin(theta);
+        const cv::Point in(cvRound(center.x + 0.7f * radius * dx), cvRound(center.y + 0.7f * radius * dy));
+        const cv::Point out(cvRound(center.x + 1.3f * radius * dx), cvRound(center.y + 1.3f * radius * dy));
+        if (out.x < 0 || out.y < 0 || out.x >= depth_.cols || out.y >= depth_.rows ||
+            in.x < 0 || in.y < 0 || in.x >= depth_.cols || in.y >= depth_.rows)
+        {
+            continue;
+        }
+
+        const uint16_t d_in = depth_.at<uint16_t>(in), d_out = depth_.at<uint16_t>(out);
+        if (d_in == 0 || d_out == 0)
+        {
+            continue;
+        }
+        ++valid;
+        if (std::abs((int)d_in - (int)d_out) >= min_step)
+        {
+            ++step;
+        }
+    }
+    return valid < samples / 4 ? 0.0f : (float)step / valid;
+}
+
+float CircleTracker::focalFromLookup(const cv::Mat &lookup_x)
+{
+    if (lookup_x.empty() || lookup_x.cols < 2)
+    {
+        return 0;
+    }
+    const int r = lookup_x.rows / 2, c = lookup_x.cols / 2;
+    const float dx = lookup_x.at<float>(r, c) - lookup_x.at<float>(r, c - 1);
+    return dx > 0 ? 1.0f / dx : 0;
+}
+
+cv::Mat CircleTracker::preprocess(const cv::Mat &color, int scale, bool half, cv::Mat &gray_buf, cv::Mat &out_buf, int &factor)
+{
+    // 先转灰度, 之后的降采样和滤波只处理单通道(均值滤波与灰度转换均为线性, 交换顺序结果不变)
+    cv::Mat gray = CircleVoter::reuseBuffer(gray_buf, color.size(), CV_8UC1);
+    cv::cvtColor(color, gray, cv::COLOR_BGR2GRAY);
+
+    factor = 1;
+    if (half)
+    {
+        factor = 2;
+        cv::Mat small = CircleVoter::reuseBuffer(half_buf_, cv::Size(gray.cols / 2, gray.rows / 2), CV_8UC1);
+        cv::resize(gray, small, small.size(), 0, 0, cv::INTER_AREA);
+        gray = small;
+    }
+
+    // 均值滤波为可分离的行列盒式滤波; gray 为复用缓存的子矩阵, 边界只按自身外推
+    const int ksize = std::max(params_.blur_size / (scale * factor), 3);
+    cv::Mat out = CircleVoter::reuseBuffer(out_buf, gray.size(), CV_8UC1);
+    cv::blur(gray, out, cv::Size(ksize, ksize), cv::Point(-1, -1), cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
+    return out;
+}
+
+float CircleTracker::edgeSupport(const cv::Mat &gray, const cv::Point2f &center, float radius)
+{
+    const int samples = 64;
+    const float min_magnitude = 20.0f; // 3x3 Sobel 下的最小梯度幅值
+    const float min_cos = 0.8f;        // 梯度与径向夹角小于约37度
+
+    int valid = 0, support = 0;
+    for (int i = 0; i < samples; i++)
+    {
+        const float theta = 2.0f * (float)CV_PI * i / samples;
+        const float dx = std::cos(theta), dy = std::sin(theta);
+        const int x = cvRound(center.x + radius * dx);
+        const int y = cvRound(center.y + radius * dy);
+        if (x < 1 || y < 1 || x >= gray.cols - 1 || y >= gray.rows - 1)
+        {
+            continue;
+        }
+        ++valid;
+
+        const uchar *up = gray.ptr<uchar>(y - 1), *mid = gray.ptr<uchar>(y), *down = gray.ptr<uchar>(y + 1);
+        const float gx = (up[x + 1] + 2 * mid[x + 1] + down[x + 1]) - (up[x - 1] + 2 * mid[x - 1] + down[x - 1]);
+        const float gy = (down[x - 1] + 2 * down[x] + down[x + 1]) - (up[x - 1] + 2 * up[x] + up[x + 1]);
+        const float magnitude = std::sqrt(gx * gx + gy * gy);
+        if (magnitude >= min_magnitude && std::abs(gx * dx + gy * dy) >= min_cos * magnitude)
+        {
+            ++support;
+        }
+    }
+
+    // 圆周大部分在图像外时不可信
+    return valid < samples / 2 ? 0.0f : (float)support / samples;
+}
@@ -0,0 +1,168 @@
+#include "oil_detect/circle_voter.h"
+
+#include <cmath>
+#include <algorithm>
+
+cv::Mat CircleVoter::reuseBuffer(cv::Mat &buffer, const cv::Size &size, int type)
+{
+    // 只在缓存不够大时重新分配, 否则返回左上角的子矩阵
+    if (buffer.type() != type || buffer.cols < size.width || buffer.rows < size.height)
+    {
+        buffer.create(std::max(size.height, buffer.rows), std::max(size.width, buffer.cols), type);
+    }
+    return buffer(cv::Rect(0, 0, size.width, size.height));
+}
+
+void CircleVoter::detect(const cv::Mat &gray, int min_radius, int max_radius, float min_dist, std::vector<cv::Vec3f> &circles)
+{
+    circles.clear();
+    min_radius = std::max(min_radius, 1);
+    max_radius = std::max(max_radius, min_radius);
+    if (gray.rows < 3 || gray.cols < 3)
+    {
+        return;
+    }
+
+    // 梯度与边缘, canny直接使用同一组梯度; gray 可能是复用缓存的子矩阵, 边界只按自身外推
+    cv::Mat dx = reuseBuffer(dx_, gray.size(), CV_16SC1);
+    cv::Mat dy = reuseBuffer(dy_, gray.size(), CV_16SC1);
+    cv::Mat edges = reuseBuffer(edges_, gray.size(), CV_8UC1);
+    cv::Sobel(gray, dx, CV_16S, 1, 0, 3, 1, 0, cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
+    cv::Sobel(gray, dy, CV_16S, 0, 1, 3, 1, 0, cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
+    cv::Canny(dx, dy, edges, std::max(params_.canny_threshold / 2, 1.0), params_.canny_threshold);
+
+    vote(dx, dy, edges, min_radius, max_radius);
+    findCenters(gray.size());
+
+    // 按票数依次估计半径, 与已接受的圆心距离过近的跳过
+    const float min_dist2 = min_dist * min_dist;
+    const int accum_step = gray.cols + 2;
+    for (const auto &center : centers_)
+    {
+        const cv::Point c(center.second % accum_step - 1, center.second / accum_step - 1);
+        bool too_close = false;
+        for (const auto &circle : circles)
+        {
+            const float ddx = circle[0] - c.x, ddy = circle[1] - c.y;
+            too_close |= ddx * ddx + ddy * ddy < min_dist2;
+        }
+        if (too_close)
+        {
+            continue;
+        }
+
+        const int radius = estimateRadius(c, min_radius, max_radius);
+        if (radius > 0)
+        {
+            circles.push_back(cv::Vec3f(c.x, c.y, radius));
+        }
+    }
+}
+
+void CircleVoter::vote(const cv::Mat &dx, const cv::Mat &dy, const cv::Mat &edges, int min_radius, int max_radius)
+{
+    const int shift = 10, one = 1 << shift;
+    const int rows = edges.rows, cols = edges.cols;
+
+    cv::Mat accum = reuseBuffer(accum_, cv::Size(cols + 2, rows + 2), CV_32SC1);
+    accum.setTo(0);
+    edge_points_.clear();
+
+    for (int y = 0; y < rows; y++)
+    {
+        const uchar *itE = edges.ptr<uchar>(y);
+        const short *itX = dx.ptr<short>(y);
+        const short *itY = dy.ptr<short>(y);
+        for (int x = 0; x < cols; x++)
+        {
+            const float vx = itX[x], vy = itY[x];
+            if (!itE[x] || (vx == 0 && vy == 0))
+            {
+                continue;
+            }
+            edge_points_.push_back(cv::Point(x, y));
+
+            // 沿梯度正反两个方向, 对 [min_radius, max_radius] 距离处的圆心投票(定点数步进)
+            const float mag = std::sqrt(vx * vx + vy * vy);
+            int sx = cvRound(vx * one / mag), sy = cvRound(vy * one / mag);
+            const int x0 = x * one + (one >> 1), y0 = y * one + (one >> 1);
+            for (int k = 0; k < 2; k++, sx = -sx, sy = -sy)
+            {
+                int x1 = x0 + min_radius * sx, y1 = y0 + min_radius * sy;
+                for (int r = min_radius; r <= max_radius; r++, x1 += sx, y1 += sy)
+                {
+                    const int x2 = x1 >> shift, y2 = y1 >> shift;
+                    if ((unsigned)x2 >= (unsigned)cols || (unsigned)y2 >= (unsigned)rows)
+                    {
+                        break;
+                    }
+                    ++accum.ptr<int>(y2 + 1)[x2 + 1];
+                }
+            }
+        }
+    }
+}
+
+void CircleVoter::findCenters(const cv::Size &size)
+{
+    const cv::Mat accum = accum_(cv::Rect(0, 0, size.width + 2, size.height + 2));
+    const int threshold = params_.acc_threshold;
+    const int step = size.width + 2;
+
+    // 4邻域局部极大且超过阈值的点为圆心候选
+    centers_.clear();
+    for (int y = 1; y <= size.height; y++)
+    {
+        const int *up = accum.ptr<int>(y - 1), *mid = accum.ptr<int>(y), *down = accum.ptr<int>(y + 1);
+        for (int x = 1; x <= size.width; x++)
+        {
+            const int v = mid[x];
+            if (v > threshold && v > mid[x - 1] && v >= mid[x + 1] && v > up[x] && v >= down[x])
+            {
+                centers_.push_back(std::make_pair(v, y * step + x));
+            }
+        }
+    }
+
+    const size_t count = std::min<size_t>(centers_.size(), params_.max_centers);
+    std::partial_sort(centers_.begin(), centers_.begin() + count, centers_.end(),
+                      [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+                          return a.first > b.first || (a.first == b.first && a.second < b.second);
+                      });
+    centers_.resize(count);
+}
+
+int CircleVoter::estimateRadius(const cv::Point &center, int min_radius, int max_radius)
+{
+    // 边缘点到圆心距离的直方图
+    radius_hist_.assign(max_radius + 2, 0);
+    const int min_r2 = min_radius * min_radius, max_r2 = max_radius * max_radius;
+    for (const auto &p : edge_points_)
+    {
+        const int ddx = p.x - center.x, ddy = p.y - center.y;
+        if (std::abs(ddx) > max_radius || std::abs(ddy) > max_radius)
+        {
+            continue;
+        }
+        const int d2 = ddx * ddx + ddy * ddy;
+        if (d2 >= min_r2 && d2 <= max_r2)
+        {
+            ++radius_hist_[cvRound(std::sqrt((float)d2))];
+        }
+    }
+
+    // 取相邻3个半径的支持点数最多者, 以支持点数/半径比较, 避免偏向大圆
+    int best_r = -1;
+    float best_ratio = 0;
+    for (int r = min_radius; r <= max_radius; r++)
+    {
+        const int support = radius_hist_[r - 1] + radius_hist_[r] + radius_hist_[r + 1];
+        const float ratio = (float)support / r;
+        if (support >= params_.acc_threshold && ratio > best_ratio)
+        {
+            best_ratio = ratio;
+            best_r = r;
+        }
+    }
+    return best_r;
+}
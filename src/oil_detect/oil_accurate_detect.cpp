@@ -6,12 +6,20 @@
 #include <pcl/features/normal_3d.h>
 #include <pcl/filters/extract_indices.h>
 #include <pcl/keypoints/uniform_sampling.h>
-#include <pcl/filters/voxel_grid.h> //体素滤波相关
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 OilAccurateDetect::OilAccurateDetect()
     : cloud_(new PCLPointCloud), cloud_voxel_(new PCLPointCloud), oil_cloud_(new PCLPointCloud),
-      plane_cloud_(new PCLPointCloud), not_plane_cloud_(new PCLPointCloud)
+      plane_cloud_(new PCLPointCloud), not_plane_cloud_(new PCLPointCloud), voxel_buffer_(new PCLPointCloud)
 {
+    // 加油口圆拟合: 3mm阈值, 半径0.040~0.043
+    workspace_.circle_fit.params().distance_threshold = 0.003f;
+    workspace_.circle_fit.params().min_radius = 0.04f;
+    workspace_.circle_fit.params().max_radius = 0.043f;
+    workspace_.circle_fit.params().max_iterations = 1000;
 }
 
 OilAccurateDetect::~OilAccurateDetect()
@@ -48,11 +56,12 @@ void OilAccurateDetect::saveDataFrame(const std::string save_folder, const std::
     pcl::io::savePCDFile(notplane_cloud_path, *not_plane_cloud_);
 }
 
-void OilAccurateDetect::planeToQuat(pcl::ModelCoefficients coef, float *quat)
+void OilAccurateDetect::planeToQuat(const pcl::ModelCoefficients &coef, float *quat)
 {
-    // 根据平面法线（z轴），求x，y轴
-    auto normal = correctionNormalDirection(cloud_voxel_, coef.values[0], coef.values[1], coef.values[2], coef.values[3]);
-    Eigen::Vector3d z(normal[0], normal[1], normal[2]);
+    // 根据平面法线（z轴），求x，y轴; 平面正侧的点更多时反向法线(两侧点数由 classifyPoints 统计)
+    cout << positive_num_ << ", " << negative_num_ << endl;
+    const double sign = positive_num_ > negative_num_ ? -1.0 : 1.0;
+    Eigen::Vector3d z(sign * coef.values[0], sign * coef.values[1], sign * coef.values[2]);
     Eigen::Vector3d v(0, 0, 1.0);
     auto x = z.cross(v);
     x = x.normalized();
@@ -73,86 +82,50 @@ void OilAccurateDetect::planeToQuat(pcl::ModelCoefficients coef, float *quat)
 
 int OilAccurateDetect::poseDetect()
 {
-    // 体素化点云
-    pcl::VoxelGrid<pcl::PointXYZ> sor;
-    sor.setInputCloud(cloud_); //给滤波对象设置需过滤的点云
-    float grid_size = 0.0005f;
-    sor.setLeafSize(grid_size, grid_size, grid_size); //设置滤波时创建的体素大小
-    sor.filter(*cloud_voxel_);                        //执行滤波处理
+    // 体素化点云(0.5mm), 输入已在格点上(如 TSDF 体素中心)时直接使用输入
+    cloud_voxel_ = voxel_filter_.filter(*cloud_, *voxel_buffer_) ? voxel_buffer_ : cloud_;
 
     /// 平面拟合 // 平面方程: ax+by+cz+d = 0
-    std::vector<int> indices(0);
-    pcl::SACSegmentation<pcl::PointXYZ> seg;
-    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-    pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-    seg.setInputCloud(cloud_voxel_);
-    // seg.setAxis();
-
-    seg.setOptimizeCoefficients(false);
-    seg.setModelType(pcl::SACMODEL_PLANE);
-    seg.setMethodType(pcl::SAC_RANSAC);
-    seg.setDistanceThreshold(0.001);
-    seg.setMaxIterations(10000);
-    seg.segment(*inliers, *coefficients);
-
-    if (inliers->indices.size() < 100)
+    pcl::PointIndices &inliers = *workspace_.inliers;
+    pcl::ModelCoefficients &coefficients = *workspace_.plane;
+    workspace_.plane_ransac.setInputCloud(*cloud_voxel_);
+    if (!workspace_.plane_ransac.segment(inliers, coefficients) || inliers.indices.size() < 100)
     {
         std::cout << "[OilAccurateDetect] "
                   << "plane point nuw is too less!" << std::endl;
         return -1;
     }
     std::cout << "[OilAccurateDetect] "
-              << "平面局内点数：" << inliers->indices.size() << std::endl;
+              << "平面局内点数：" << inliers.indices.size() << ", 迭代次数：" << workspace_.plane_ransac.iterations() << std::endl;
+
+    // 单次遍历: 平面点, 平面上方1~10cm的点, 两侧点数
+    classifyPoints(coefficients, workspace_.plane_ransac.params().distance_threshold, 0.01f, 0.1f);
 
     // oil 旋转四元数
-    planeToQuat(*coefficients, oil_quat_);
-    cout << *coefficients << endl;
+    planeToQuat(coefficients, oil_quat_);
+    cout << coefficients << endl;
     std::cout << "[OilAccurateDetect] "
               << "oil_quat_: " << oil_quat_[0] << "," << oil_quat_[1] << "," << oil_quat_[2] << "," << oil_quat_[3] << std::endl;
 
-    pcl::ExtractIndices<pcl::PointXYZ> extract;
-    extract.setInputCloud(cloud_voxel_);
-    extract.setIndices(inliers);
-    extract.setNegative(true);
-    extract.filter(indices);
-
-    extract.setInputCloud(cloud_voxel_);
-    extract.setIndices(inliers);
-    extract.setNegative(false);
-    extract.filter(*plane_cloud_);
-
-    auto not_plane_idx = extractAbovePlane(cloud_voxel_,
-                                           coefficients->values[0], coefficients->values[1],
-                                           coefficients->values[2], coefficients->values[3],
-                                           0.01, 0.1);
-    inliers->indices = not_plane_idx;
-
-    extract.setInputCloud(cloud_voxel_);
-    extract.setIndices(inliers);
-    extract.setNegative(false);
-    extract.filter(*not_plane_cloud_);
-
-    if (inliers->indices.size() > 100)
+    if (not_plane_cloud_->size() > 100)
     {
-        // *********** 圆模型
-        pcl::SACSegmentation<pcl::PointXYZ> seg_circle;
-        pcl::ModelCoefficients coefficients_circle;
-        seg_circle.setInputCloud(not_plane_cloud_);
-        // seg_circle.setIndices(inliers);
-        seg_circle.setOptimizeCoefficients(false);
-        seg_circle.setModelType(pcl::SACMODEL_CIRCLE3D);
-        seg_circle.setAxis({coefficients->values[0], coefficients->values[1],
-                            coefficients->values[2]});
-        seg_circle.setRadiusLimits(0.04, 0.043);
-        seg_circle.setMethodType(pcl::SAC_RANSAC);
-        seg_circle.setDistanceThreshold(0.003);
-        seg_circle.setMaxIterations(1000);
-        seg_circle.segment(*inliers, coefficients_circle);
-
-        extract.setInputCloud(not_plane_cloud_);
-        extract.setIndices(inliers);
-        extract.setNegative(false);
-        extract.filter(*oil_cloud_);
+        // *********** 圆模型: 投影到平面内拟合
+        pcl::ModelCoefficients &coefficients_circle = *workspace_.circle;
+        const Eigen::Vector4f plane(coefficients.values[0], coefficients.values[1],
+                                    coefficients.values[2], coefficients.values[3]);
+        workspace_.circle_fit.setInputCloud(*not_plane_cloud_, plane);
+        if (!workspace_.circle_fit.fit(inliers, coefficients_circle))
+        {
+            std::cout << "[OilAccurateDetect] "
+                      << "circle fitting failed!" << std::endl;
+            return -1;
+        }
+
+        oil_cloud_->resize(inliers.indices.size());
+        for (size_t i = 0; i < inliers.indices.size(); i++)
+        {
+            oil_cloud_->points[i] = not_plane_cloud_->points[inliers.indices[i]];
+        }
 
         // oil 平移
         cout << coefficients_circle << endl;
@@ -161,54 +134,88 @@ int OilAccurateDetect::poseDetect()
         oil_trans_[2] = coefficients_circle.values[2];
         std::cout << "[OilAccurateDetect] "
                   << "oil_trans_: " << oil_trans_[0] << "," << oil_trans_[1] << "," << oil_trans_[2] << std::endl;
+
+        workspace_.poseCovariance(oil_cov_);
+        std::cout << "[OilAccurateDetect] "
+                  << "平面残差: " << workspace_.plane_ransac.quality().rms << ", 圆残差: " << workspace_.circle_fit.quality().rms
+                  << ", 位置标准差: " << DetectorWorkspace::positionSigma(oil_cov_) << std::endl;
     }
 
     return 0;
 }
 
-std::vector<int> OilAccurateDetect::extractAbovePlane(PCLPointCloud::Ptr cloud, float A, float B, float C, float D, float min_dis, float max_dis)
+void OilAccurateDetect::classifyPoints(const pcl::ModelCoefficients &coef, float plane_thr, float min_dis, float max_dis)
 {
-    std::vector<int> idx;
-
-    auto down = std::sqrt(std::pow(A, 2) + std::pow(B, 2) + std::pow(C, 2));
-
-    for (int i = 0; i < cloud->size(); i++)
+    const float norm = std::sqrt(coef.values[0] * coef.values[0] + coef.values[1] * coef.values[1] + coef.values[2] * coef.values[2]);
+    const float A = coef.values[0] / norm, B = coef.values[1] / norm, C = coef.values[2] / norm, D = coef.values[3] / norm;
+
+    const int n = (int)cloud_voxel_->size();
+    const PCLPoint *points = cloud_voxel_->points.data();
+    labels_.resize(n);
+    plane_cloud_->resize(n); // 按上限预分配, 容量在多帧间保留
+    not_plane_cloud_->resize(n);
+
+#ifdef _OPENMP
+    const int max_threads = omp_get_max_threads();
+#else
+    const int max_threads = 1;
+#endif
+    chunk_counts_.assign(2 * max_threads, 0);
+    size_t positive = 0, negative = 0;
+
+    // 各线程处理连续的一段: 先算距离与标记并计数, 再按前面各段的计数写到输出中的对应位置, 输出保持原顺序
+#pragma omp parallel reduction(+ : positive, negative)
     {
-        auto point = cloud->at(i);
-        // 计算距离
-        auto dis = abs(A * point.x + B * point.y + C * point.z + D) / down;
-        if (dis >= min_dis && dis <= max_dis)
+#ifdef _OPENMP
+        const int threads = omp_get_num_threads(), t = omp_get_thread_num();
+#else
+        const int threads = 1, t = 0;
+#endif
+        const int begin = (int)((int64_t)n * t / threads), end = (int)((int64_t)n * (t + 1) / threads);
+
+        int plane_num = 0, band_num = 0;
+        uint8_t *labels = labels_.data();
+#pragma omp simd reduction(+ : plane_num, band_num, positive, negative)
+        for (int i = begin; i < end; i++)
         {
-            idx.push_back(i);
+            const float dis = A * points[i].x + B * points[i].y + C * points[i].z + D;
+            const float abs_dis = std::abs(dis);
+            const uint8_t on_plane = abs_dis <= plane_thr ? 1 : 0;
+            const uint8_t in_band = (abs_dis >= min_dis && abs_dis <= max_dis) ? 2 : 0;
+            labels[i] = on_plane | in_band;
+            plane_num += on_plane;
+            band_num += in_band >> 1;
+            positive += dis >= min_dis ? 1 : 0;
+            negative += dis <= -min_dis ? 1 : 0;
         }
-    }
+        chunk_counts_[2 * t] = plane_num;
+        chunk_counts_[2 * t + 1] = band_num;
 
-    return idx;
-}
-
-std::vector<float> OilAccurateDetect::correctionNormalDirection(PCLPointCloud::Ptr cloud, float A, float B, float C, float D)
-{
-    std::vector<int> positive_idx;
-    std::vector<int> negative_idx;
-
-    auto down = std::sqrt(std::pow(A, 2) + std::pow(B, 2) + std::pow(C, 2));
-
-    for (int i = 0; i < cloud->size(); i++)
-    {
-        auto point = cloud->at(i);
-        // 计算距离
-        auto dis = A * point.x + B * point.y + C * point.z + D / down;
-        float min_dis = 0.01;
-        if (dis >= min_dis)
-            positive_idx.push_back(i);
-        else if (dis <= -min_dis)
-            negative_idx.push_back(i);
+#pragma omp barrier
+        size_t plane_pos = 0, band_pos = 0;
+        for (int k = 0; k < t; k++)
+        {
+            plane_pos += chunk_counts_[2 * k];
+            band_pos += chunk_counts_[2 * k + 1];
+        }
+        PCLPoint *plane_out = plane_cloud_->points.data(), *band_out = not_plane_cloud_->points.data();
+        for (int i = begin; i < end; i++)
+        {
+            if (labels[i] & 1)
+                plane_out[plane_pos++] = points[i];
+            if (labels[i] & 2)
+                band_out[band_pos++] = points[i];
+        }
     }
-    cout << positive_idx.size() << ", " << negative_idx.size() << endl;
-    if (positive_idx.size() > negative_idx.size())
+
+    size_t plane_total = 0, band_total = 0;
+    for (int k = 0; k < max_threads; k++)
     {
-        // 反向法线
-        return std::vector<float>{-A, -B, -C};
+        plane_total += chunk_counts_[2 * k];
+        band_total += chunk_counts_[2 * k + 1];
     }
-    return std::vector<float>{A, B, C};
+    plane_cloud_->resize(plane_total);
+    not_plane_cloud_->resize(band_total);
+    positive_num_ = positive;
+    negative_num_ = negative;
 }
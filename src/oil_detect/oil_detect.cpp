@@ -1,6 +1,6 @@
+#include <thread>
 #include <utility>
 
-#include <tf/transform_listener.h>
 #include <ros/ros.h>
 
 #include <fstream>
@@ -40,27 +40,81 @@ void plotFrame(pcl::visualization::PCLVisualizer::Ptr &viewer, const Eigen::Vect
     }
 }
 
-OilFillerPose::OilFillerPose(ros::NodeHandle &node, std::shared_ptr<CameraReceiver> camera_receiver, std::string camera_frame, int rate)
-    : camera_frame_(std::move(camera_frame)), rate_(rate), buff_size_(20)
+// 在显示图像上绘制检测结果, scale 为显示图像相对检测所用层的缩放
+static void drawDetection(cv::Mat &image, const ShowSnapshot &snap, double scale)
+{
+    if (!snap.detected)
+    {
+        return;
+    }
+    const cv::Point center(cvRound(snap.center.x * scale), cvRound(snap.center.y * scale));
+    const int radius = cvRound(snap.pixel_radius * scale);
+    //绘制圆心
+    circle(image, center, 4, cv::Scalar(0, 255, 0), -1, 8, 0);
+    //绘制圆轮廓: 验证通过的预测为青色, 完整检测为红色
+    circle(image, center, radius, snap.verified ? cv::Scalar(255, 255, 0) : cv::Scalar(0, 0, 255), 2, 8, 0);
+    if (!snap.verified)
+    {
+        const cv::Rect rect(cvRound(snap.rect.x * scale), cvRound(snap.rect.y * scale),
+                            cvRound(snap.rect.width * scale), cvRound(snap.rect.height * scale));
+        cv::rectangle(image, rect, cvScalar(0, 255, 255), 2, 8, 0);
+    }
+}
+
+// 有组织点云按 step 行/列抽稀, out 的缓存可复用
+static void decimateCloud(const pcl::PointCloud<pcl::PointXYZRGBA> &in, int step, pcl::PointCloud<pcl::PointXYZRGBA> &out)
+{
+    if (in.height <= 1 || step <= 1)
+    {
+        out = in;
+        return;
+    }
+    out.width = (in.width + step - 1) / step;
+    out.height = (in.height + step - 1) / step;
+    out.is_dense = in.is_dense;
+    out.points.resize(out.width * out.height);
+    for (uint32_t r = 0; r < out.height; r++)
+    {
+        const pcl::PointXYZRGBA *src = &in.points[r * step * in.width];
+        pcl::PointXYZRGBA *dst = &out.points[r * out.width];
+        for (uint32_t c = 0; c < out.width; c++)
+        {
+            dst[c] = src[c * step];
+        }
+    }
+}
+
+OilFillerPose::OilFillerPose(ros::NodeHandle &node, std::shared_ptr<CameraReceiver> camera_receiver, std::string camera_frame, int rate,
+                             std::shared_ptr<TfBufferService> tf_buffer)
+    : camera_frame_(std::move(camera_frame)), tf_buffer_(std::move(tf_buffer)), rate_(rate)
 {
     printf("Init ....\n");
 
-    trans_buff_.resize(3, buff_size_);
+    // 与原 SACMODEL_PLANE 参数一致(1cm阈值, 100次, 优化系数)
+    workspace_.plane_ransac.params().distance_threshold = 0.01f;
+    workspace_.plane_ransac.params().max_iterations = 100;
+    workspace_.plane_ransac.params().refine = true;
+
+    // 与原 SACMODEL_CIRCLE3D 参数一致(1cm阈值, 100次), 另加加油口半径先验
+    workspace_.circle_fit.params().distance_threshold = 0.01f;
+    workspace_.circle_fit.params().min_radius = 0.04f;
+    workspace_.circle_fit.params().max_radius = 0.043f;
+    workspace_.circle_fit.params().max_iterations = 100;
 
     // Realsense cloud and image receiver
     receiver = camera_receiver;
     ROS_INFO("Starting camera receiver...");
     receiver->run();
 
-    cloud = pcl::PointCloud<pcl::PointXYZRGBA>::Ptr(new pcl::PointCloud<pcl::PointXYZRGBA>());
+    frame_.cloud = pcl::PointCloud<pcl::PointXYZRGBA>::ConstPtr(new pcl::PointCloud<pcl::PointXYZRGBA>());
     cloud_of = pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>());
+
+    pose_pub_ = node.advertise<geometry_msgs::PoseWithCovarianceStamped>("oil_filler_pose", 1);
 }
 
 void OilFillerPose::imageViewer(int loop_rate)
 {
     std::chrono::time_point<std::chrono::high_resolution_clock> start, now;
-    double fps = 0;
-    size_t frameCount = 0;
     std::ostringstream oss;
     const cv::Point pos(5, 15);
     const cv::Scalar colorText = CV_RGB(255, 255, 255);
@@ -73,30 +127,42 @@ void OilFillerPose::imageViewer(int loop_rate)
 
     start = std::chrono::high_resolution_clock::now();
 
+    // 只在有新快照时绘制, 绘制缓存尺寸不变时复用
+    cv::Mat color_draw;
+    uint64_t shown = 0, processed = 0;
     ros::Rate rate(loop_rate);
     for (; running && ros::ok();)
     {
-        ++frameCount;
+        const ShowSnapshotPtr snap = getSnapshot();
+
+        // 检测帧率由检测线程的累计处理帧数计算, 与显示频率无关
         now = std::chrono::high_resolution_clock::now();
         double elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() / 1000.0;
-        if (elapsed >= 1.0)
+        if (elapsed >= 1.0 && snap)
         {
-            fps = int(frameCount / elapsed);
+            const double fps = (snap->processed - processed) / elapsed;
             oss.str("");
-            oss << "fps: " << frame_rate_ << " ( " << int(1000.0 / frame_rate_) << " ms)";
+            oss << "fps: " << int(fps) << " ( " << (fps > 0 ? int(1000.0 / fps) : 0) << " ms)";
+            processed = snap->processed;
             start = now;
-            frameCount = 0;
         }
 
-        if (!color_draw.empty())
+        if (snap && snap->seq != shown && !snap->color.empty())
         {
-            cv::Mat color_show(color_draw);
-            if (color_draw.cols > 800)
+            shown = snap->seq;
+            double scale = 1.0;
+            if (snap->color.cols > 800)
+            {
+                scale = 0.7;
+                cv::resize(snap->color, color_draw, cv::Size(0, 0), scale, scale, cv::INTER_LINEAR);
+            }
+            else
             {
-                resize(color_show, color_show, cv::Size(0, 0), 0.7, 0.7, cv::INTER_LINEAR);
+                snap->color.copyTo(color_draw);
             }
-            cv::putText(color_show, oss.str(), pos, font, sizeText, colorText, lineText, CV_AA);
-            cv::imshow("Image Viewer", color_show);
+            drawDetection(color_draw, *snap, scale);
+            cv::putText(color_draw, oss.str(), pos, font, sizeText, colorText, lineText, CV_AA);
+            cv::imshow("Image Viewer", color_draw);
         }
 
         int key = cv::waitKey(1);
@@ -104,11 +170,12 @@ void OilFillerPose::imageViewer(int loop_rate)
         {
         case 27:
         case 'q':
+            quit_ = true;
             running = false;
             break;
         case ' ':
         case 's':
-            saveCloudAndImages();
+            save = true;
             break;
         }
 
@@ -116,8 +183,6 @@ void OilFillerPose::imageViewer(int loop_rate)
     }
     cv::destroyAllWindows();
     cv::waitKey(100);
-
-    receiver->stop();
 }
 
 void OilFillerPose::cloudViewer(int loop_rate)
@@ -125,7 +190,8 @@ void OilFillerPose::cloudViewer(int loop_rate)
     // PCLVisualizer初始化
     pcl::visualization::PCLVisualizer::Ptr visualizer(new pcl::visualization::PCLVisualizer("Cloud Viewer"));
     const std::string cloudName = "rendered";
-    visualizer->addPointCloud(cloud, cloudName);
+    pcl::PointCloud<pcl::PointXYZRGBA>::Ptr display(new pcl::PointCloud<pcl::PointXYZRGBA>());
+    visualizer->addPointCloud(display, cloudName);
     visualizer->setPointCloudRenderingProperties(pcl::visualization::PCL_VISUALIZER_POINT_SIZE, 1, cloudName);
     visualizer->initCameraParameters();
     visualizer->setBackgroundColor(0, 0, 0);
@@ -133,61 +199,49 @@ void OilFillerPose::cloudViewer(int loop_rate)
     visualizer->setCameraPosition(0, 0, 0, 0, -1, 0);
     visualizer->registerKeyboardCallback(&OilFillerPose::keyboardEvent, *this, (void *)visualizer.get());
 
-    ros::Rate rate(loop_rate); // 与采集频率接近即可
-    int count = 0;
-    auto start = std::chrono::high_resolution_clock::now();
+    uint64_t shown = 0;
+    ros::Rate rate(loop_rate);
     while (ros::ok() && running && !visualizer->wasStopped())
     {
-        count++;
-        auto now = std::chrono::high_resolution_clock::now();
-        double elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count() / 1000.0;
-        if (elapsed >= 1)
+        // 只读取最新的结果快照, 渲染快慢不影响检测
+        const ShowSnapshotPtr snap = getSnapshot();
+        if (snap && snap->seq != shown && snap->cloud)
         {
-            // std::cout << "#################################################" << std::endl;
-            frame_rate_ = count;
-            // std::cout << "frame_rate_ " << frame_rate_ << std::endl;
-            // std::cout << "#################################################" << std::endl;
-            count = 0;
-            start = now;
-        }
-
-        visualizer->removeAllShapes();
-
-        pcl::copyPointCloud(*receiver->getCloud(), *cloud); // copy原始点云
+            shown = snap->seq;
+            visualizer->removeAllShapes();
+            if (snap->posed)
+            {
+                ofPoseShow(visualizer, *snap); // 显示加油口姿态
+            }
 
-        if (ofDetect() && ofPlaneCal())
-        {                           // 检测到加油口, 平面拟合成功
-            ofCenterCal();          // 加油口中心坐标计算
-            ofPoseCal();            // 加油口姿态解算
-            ofPoseShow(visualizer); // 显示加油口姿态
-            publishTF();            // 发布加油口姿态
+            // 更新点云显示, 检测用的是降采样层时不再抽稀
+            decimateCloud(*snap->cloud, snap->source && snap->cloud != snap->source->levels[0].cloud ? 1 : show_step_, *display);
+            visualizer->updatePointCloud(display, cloudName);
         }
 
-        // 更新点云显示
-        visualizer->updatePointCloud(cloud, cloudName);
-
         if (save)
         { // 保存点云及结果
-            saveCloudAndImages();
+            if (snap && snap->source)
+            {
+                saveCloudAndImages(*snap);
+            }
             save = false;
         }
 
         visualizer->spinOnce(10);
-
-        ros::spinOnce();
         rate.sleep();
     }
 
-    printf("[INFO] Exit oil filter detector...\n");
+    running = false;
+    printf("[INFO] Exit cloud viewer...\n");
     visualizer->close();
 }
 
-void OilFillerPose::getCameraPose(std::string source_frame, std::string target_frame, tf::StampedTransform &transform, std::string save_path = "")
+bool OilFillerPose::getCameraPose(std::string source_frame, std::string target_frame, const ros::Time &stamp,
+                                  tf::StampedTransform &transform, std::string save_path)
 {
-    tf::TransformListener listener;
-
-    listener.waitForTransform(target_frame, source_frame, ros::Time(0), ros::Duration(3));
-    listener.lookupTransform(target_frame, source_frame, ros::Time(0), transform);
+    if (!tf_buffer_->lookup(target_frame, source_frame, stamp, transform))
+        return false;
 
     tf::Matrix3x3 roat(transform.getRotation());
 
@@ -201,9 +255,10 @@ void OilFillerPose::getCameraPose(std::string source_frame, std::string target_f
 
         OutFile.close();
     }
+    return true;
 }
 
-void OilFillerPose::saveCloudAndImages()
+void OilFillerPose::saveCloudAndImages(const ShowSnapshot &snap)
 {
     std::string baseName, cloudName, colorName, colorDrawName, depthName, camera_pose;
     std::string save_path = "/home/waha/Pictures/oil_pose_detect/";
@@ -219,7 +274,7 @@ void OilFillerPose::saveCloudAndImages()
         depthName = save_path + "frame_" + baseName + "_depth" + ".png";
         tf::StampedTransform transform;
         camera_pose = save_path + "frame_" + baseName + "_pose" + ".txt";
-        getCameraPose("camera_rgb_optical_frame", "base_link", transform, camera_pose);
+        getCameraPose("camera_rgb_optical_frame", "base_link", snap.stamp, transform, camera_pose);
 
         // if ((access(cloudName.c_str(), 0)) == 0)
         // { // 0已存在,-1不存在
@@ -232,14 +287,19 @@ void OilFillerPose::saveCloudAndImages()
         break;
     }
 
+    // 保存快照对应帧的原始分辨率数据, 与绘制的检测结果属于同一帧
+    const CloudLevel &base = snap.source->levels[0];
+    cv::Mat color_draw = snap.color.clone();
+    drawDetection(color_draw, snap, 1.0);
+
     printf("%s\n", ("[INFO] Saving cloud: " + cloudName).c_str());
-    writer.writeBinary(cloudName, *cloud);
+    writer.writeBinary(cloudName, *base.cloud);
     printf("%s\n", ("[INFO] Saving color: " + colorName).c_str());
-    cv::imwrite(colorName, receiver->getColor(), params);
+    cv::imwrite(colorName, base.color, params);
     printf("%s\n", ("[INFO] Saving color_draw: " + colorDrawName).c_str());
     cv::imwrite(colorDrawName, color_draw, params);
     printf("%s\n", ("[INFO] Saving depth: " + depthName).c_str());
-    cv::imwrite(depthName, receiver->getDepth(), params);
+    cv::imwrite(depthName, base.depth, params);
 
     std::cout << "[INFO] Saving pose: " << camera_pose << std::endl;
 
@@ -258,6 +318,7 @@ void OilFillerPose::keyboardEvent(const pcl::visualization::KeyboardEvent &event
         {
         case 27:
         case 'q':
+            quit_ = true;
             running = false;
             printf("[ INFO] Quit...\n");
             break;
@@ -279,88 +340,136 @@ void OilFillerPose::keyboardEvent(const pcl::visualization::KeyboardEvent &event
     }
 }
 
-void OilFillerPose::publishTF()
+void OilFillerPose::publishTF(const PoseFrame &f)
 {
-    Eigen::Quaterniond quat(rot_matrix);
+    Eigen::Quaterniond quat(f.rot);
     tf::Quaternion tf_quat;
     tf::quaternionEigenToTF(quat, tf_quat);
 
-    tf::Transform of_tf = tf::Transform(tf_quat, tf::Vector3(trans[0], trans[1], trans[2]));
+    tf::Transform of_tf = tf::Transform(tf_quat, tf::Vector3(f.trans[0], f.trans[1], f.trans[2]));
 
-    broadcaster.sendTransform(tf::StampedTransform(of_tf, ros::Time::now(), camera_frame_, "oil_filler"));
+    // 以图像时间戳发布, 与跟踪及相机位姿查询一致, 不含流水线各级的处理延迟
+    broadcaster.sendTransform(tf::StampedTransform(of_tf, f.stamp, camera_frame_, "oil_filler"));
+
+    // TF 不携带不确定度, 另发布带协方差的位姿
+    geometry_msgs::PoseWithCovarianceStamped pose_msg;
+    pose_msg.header.stamp = f.stamp;
+    pose_msg.header.frame_id = camera_frame_;
+    tf::poseEigenToMsg(Eigen::Translation3d(f.trans) * quat, pose_msg.pose.pose);
+    std::copy(f.covariance, f.covariance + 36, pose_msg.pose.covariance.begin());
+    pose_pub_.publish(pose_msg);
 }
 
-bool OilFillerPose::ofDetect()
+void OilFillerPose::setDetectLevel(int level, int refine_interval, PyramidMode mode)
 {
-    color_draw = receiver->getColor().clone(); // 获取副本
+    detect_level_ = std::min(std::max(level, 0), (int)CameraReceiver::kMaxPyramidLevel);
+    refine_interval_ = refine_interval;
+    receiver->requestPyramidLevel(detect_level_, mode);
+}
 
-    if (cloud->points.empty())
+void OilFillerPose::grabFrame(PoseFrame &f, const CloudFramePtr &source)
+{
+    // 跟踪时使用降采样层, 每隔 refine_interval_ 帧用原始分辨率精检
+    f.level = detect_level_;
+    if (f.level > 0 && refine_interval_ > 0 && iteration_ % refine_interval_ == 0)
     {
-        printf("[Erro] Origin cloud is empty!\n");
-        return false; // 空点云, 跳过
+        f.level = 0;
     }
+    ++iteration_;
 
-    /// 检测加油口
-    // 均值滤波
-    cv::Mat img_blur;
-    blur(receiver->getColor(), img_blur, cv::Size(10, 10));
-
-    // 灰度转换
-    cv::Mat img_gray;
-    cvtColor(img_blur, img_gray, cv::COLOR_BGR2GRAY);
-
-    // 霍夫变换圆检测
-    vector<cv::Vec3f> circles;
-    // 参数:      默认, 最小间距, canny上限, 阈值(越大越圆), 最小半径, 最大半径
-    //    HoughCircles(img_gray, circles, cv::HOUGH_GRADIENT,1, 1, 80, 60, 40, 120); // 这里的canny算法下限自动设置为上限一半
-    cv::HoughCircles(img_gray, circles, cv::HOUGH_GRADIENT, 1, 1, 80, 30, 40, 200); // 这里的canny算法下限自动设置为上限一半
+    if (f.level >= (int)source->levels.size() || !source->levels[f.level].cloud)
+    {
+        f.level = 0; // 该层尚未生成
+    }
+    const CloudLevel &level = source->levels[f.level];
+
+    f.source = source;
+    f.seq = source->seq;
+    f.stamp = source->stamp;
+    f.color = level.color;
+    f.depth = level.depth;
+    f.lookup_x = level.lookupX;
+    f.lookup_y = level.lookupY;
+    f.cloud = level.cloud;
+    f.detected = f.verified = f.posed = false;
+    receiver->markConsumed(f.seq);
+    ++processed_;
+}
 
-    if (circles.empty())
+bool OilFillerPose::ofVerify(PoseFrame &f)
+{
+    f.verified = false;
+    if (f.cloud->points.empty())
     {
-        printf("Detect 0 circles!\n");
         return false;
     }
 
-    /// 查找最大圆
-    std::vector<double> radius_vec;
-    int max_r_index = 0;
-    double max_r = 0;
-    for (int i = 0; i < circles.size(); i++)
+    const Pinhole camera = Pinhole::fromLookup(f.lookup_x, f.lookup_y);
+    const double t = f.stamp.toSec();
+    cv::Point2f center;
+    float radius;
     {
-        double radius = cvRound(circles[i][2]);
-        radius_vec.push_back(radius);
-
-        if (radius > max_r)
+        std::lock_guard<std::mutex> guard(pose_lock_);
+        if (!pose_tracker_.canVerify(t) || !pose_tracker_.predict(t, f.trans, f.rot, f.covariance) ||
+            !pose_tracker_.projectRim(camera, f.trans, center, radius))
         {
-            max_r = radius;
-            max_r_index = i;
+            return false;
+        }
+        if (!pose_tracker_.verify(*f.cloud, camera, f.trans, f.rot))
+        {
+            printf("[INFO] Track verification failed, full detection\n");
+            return false;
         }
     }
 
-    std::cout << "最大圆半径是 " << max_r << "索引是 " << max_r_index << std::endl
-              << std::endl;
+    // 预测的圆作为霍夫跟踪窗口的起点, 下一次完整检测仍可在窗口内搜索
+    CircleDetection circle_det;
+    circle_det.center = center;
+    circle_det.radius = radius;
+    circle_det.confidence = 1;
+    tracker_.accept(circle_det, 1 << f.level);
+
+    const int radius_zoom = (int)(radius * 2);
+    f.center = cv::Point(cvRound(center.x), cvRound(center.y));
+    f.rect = cv::Rect(f.center.x - radius_zoom, f.center.y - radius_zoom, 2 * radius_zoom, 2 * radius_zoom) &
+             cv::Rect(0, 0, f.color.cols, f.color.rows);
+    f.pixel_radius = radius;
+    f.verified = true;
+    f.detected = true;
+    printf("[INFO] Track verified: center %d, %d\n", f.center.x, f.center.y);
+    return true;
+}
 
-    // auto max_radius = std::max_element(radius_vec.begin(), radius_vec.end());
-    // auto indice = std::distance(radius_vec.begin(), max_radius);
-    // std::cout << "最大圆半径是 " << *max_radius << "索引是 " << indice << std::endl
-    //           << std::endl;
+bool OilFillerPose::ofDetect(PoseFrame &f)
+{
+    const int scale = 1 << f.level; // 当前层相对原图的缩放倍数
 
-    cv::Point center(cvRound(circles[max_r_index][0]), cvRound(circles[max_r_index][1]));
-    double radius = cvRound(circles[max_r_index][2]);
-    //绘制圆心
-    circle(color_draw, center, 4, cv::Scalar(0, 255, 0), -1, 8, 0);
-    //绘制圆轮廓
-    circle(color_draw, center, (int)radius, cv::Scalar(0, 0, 255), 2, 8, 0);
+    if (f.cloud->points.empty())
+    {
+        printf("[Erro] Origin cloud is empty!\n");
+        return false; // 空点云, 跳过
+    }
+
+    /// 检测加油口: 跟踪窗口内搜索, 丢失时整帧霍夫检测
+    CircleDetection circle_det;
+    tracker_.setDepthPrior(f.depth, CircleTracker::focalFromLookup(f.lookup_x));
+    if (!tracker_.detect(f.color, scale, circle_det))
+    {
+        printf("Detect 0 circles!\n");
+        return false;
+    }
+
+    cv::Point center(cvRound(circle_det.center.x), cvRound(circle_det.center.y));
+    double radius = cvRound(circle_det.radius);
 
     int radius_zoom = (int)(radius * 2); // 放大矩形框
     int x = std::max(center.x - radius_zoom, 0);
     int y = std::max(center.y - radius_zoom, 0);
-    int w = std::min(2 * radius_zoom, 640 - x);
-    int h = std::min(2 * radius_zoom, 480 - y);
+    int w = std::min(2 * radius_zoom, f.color.cols - x);
+    int h = std::min(2 * radius_zoom, f.color.rows - y);
     cv::Rect rect(x, y, w, h);
-    cv::rectangle(color_draw, rect, cvScalar(0, 255, 255), 2, 8, 0);
 
-    if (rect.x < 0 || rect.x > receiver->getColor().cols || rect.y < 0 || rect.y > receiver->getColor().rows)
+    if (rect.x < 0 || rect.x > f.color.cols || rect.y < 0 || rect.y > f.color.rows)
     {
         printf("[Erro] Bad rect!\n");
         return false;
@@ -369,86 +478,52 @@ bool OilFillerPose::ofDetect()
     printf("center: %d, %d\n", center.x, center.y);
     printf("rect: %d, %d, %d, %d\n", rect.x, rect.y, rect.width, rect.height);
 
-    of_center = center; // 获取加油口中心像素坐标
-    of_rect = rect;     // 获取加油口外接矩形
-
-    //    imshow("result", color_draw);
-    //    cv::waitKey(0);
+    f.center = center; // 获取加油口中心像素坐标
+    f.rect = rect;     // 获取加油口外接矩形
+    f.pixel_radius = (float)radius;
+    f.detected = true; // 绘制由显示线程根据快照完成
 
     return true;
 }
 
-bool OilFillerPose::ofPlaneCal()
+bool OilFillerPose::ofPlaneCal(PoseFrame &f)
 {
-    /// 获取加油口无组织无色彩点云
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_tmp(new pcl::PointCloud<pcl::PointXYZ>);
-    for (int row = of_rect.y; row < of_rect.y + of_rect.height; row++)
-    {
-        for (int col = of_rect.x; col < of_rect.x + of_rect.width; col++)
-        {
-            pcl::PointXYZRGBA p_in = cloud->points[row * cloud->width + col];
-            pcl::PointXYZ p_out;
-            p_out.x = p_in.x;
-            p_out.y = p_in.y;
-            p_out.z = p_in.z;
-            cloud_tmp->points.push_back(p_out);
-        }
-    }
-
-    printf("cloud_tmp size:%zu\n", cloud_tmp->points.size());
-    if (cloud_tmp->points.empty())
-    {
-        printf("[Erro] Cloud_tmp is empty! no point in selected area.\n");
-        return false;
-    }
-
-    /// 统计学滤波
-    // pcl::StatisticalOutlierRemoval<pcl::PointXYZ> sor;
-    // sor.setInputCloud(cloud_tmp);
-    // sor.setMeanK(50);
-    // sor.setStddevMulThresh(1.0);
-    // sor.filter(*cloud_tmp);
+    const int scale = 1 << f.level;
+    const size_t min_points = std::max(100 / (scale * scale), 10); // 降采样层的点数按面积缩小
 
-    /// 查找加油口最高点
-    std::vector<float> p_depth;
-    for (int i = 0; i < cloud_tmp->points.size(); i++)
+    /// 有组织点云: 霍夫圆外侧种子区域生长得到平面, 圆附近的深度边缘为圆孔边缘, 不展平 ROI
+    if (organized_plane_enable_ && f.cloud->height > 1 && f.pixel_radius > 0)
     {
-        const float depth = cloud_tmp->points[i].z;
-        if (!isnan(depth) && depth > 0)
+        organized_plane_.params().min_plane_points = (int)min_points;
+        organized_plane_.setInputCloud(*f.cloud, f.rect);
+        if (organized_plane_.segment(f.center, f.pixel_radius, *workspace_.inliers, *workspace_.plane, *workspace_.outliers))
         {
-            p_depth.push_back(depth);
+            const std::vector<float> &plane = workspace_.plane->values;
+            workspace_.circle_fit.setInputCloud(*f.cloud, Eigen::Vector4f(plane[0], plane[1], plane[2], plane[3]),
+                                                workspace_.outliers->indices);
+            if (workspace_.circle_fit.fit(*workspace_.inliers, *workspace_.circle))
+            {
+                printf("[INFO] organized plane %d points, rim %zu points\n", organized_plane_.quality().inliers,
+                       workspace_.outliers->indices.size());
+                return acceptFit(f, organized_plane_.quality());
+            }
         }
+        printf("[WARN] Organized plane/rim extraction failed, fall back to RANSAC\n");
     }
 
-    if (p_depth.empty())
+    /// 获取加油口最高点附近的无组织无色彩点云: 单趟并行提取 ROI 内有效点与最高点, 再筛选最高点以下 10cm 内的点
+    workspace_.reserve(f.rect.area());
+    const DetectorWorkspace::BandStats roi = workspace_.extractBand(*f.cloud, f.rect.x, f.rect.y, f.rect.width, f.rect.height,
+                                                                    0.1, *cloud_of); /// 关键参数
+    printf("roi valid points:%d\n", roi.valid);
+    if (roi.valid == 0)
     {
-        printf("[Erro] Could not get min_depth!\n");
-        //        writer.writeBinary("/home/sdhm/cloud_tmp.pcd", *cloud_tmp);
+        printf("[Erro] Could not get min_depth! no valid point in selected area.\n");
         return false;
     }
-    auto min_depth = std::min_element(p_depth.begin(), p_depth.end());
-    double MinDepth = *min_depth;
-    std::cout << "最高点是 " << *min_depth << std::endl
+    std::cout << "最高点是 " << roi.min_depth << std::endl
               << std::endl;
 
-    if (isnan(MinDepth))
-    {
-        printf("[Erro] 最高点无效!\n");
-        //        writer.writeBinary("/home/sdhm/cloud_tmp.pcd", *cloud_tmp);
-        return false; // 无效最高点
-    }
-
-    /// 分割最高点附近点云
-    cloud_of->clear();
-    for (int i = 0; i < cloud_tmp->points.size(); i++)
-    {
-        const pcl::PointXYZ p = cloud_tmp->points[i];
-        if (p.z > 0 && p.z < MinDepth + 0.1)
-        { /// 关键参数
-            cloud_of->push_back(p);
-        }
-    }
-
     /// 平面拟合 // 平面方程: ax+by+cz+d = 0
     // PCLVisualizer初始化
     // pcl::visualization::PCLVisualizer::Ptr visualizer2(new pcl::visualization::PCLVisualizer("Cloud Viewer2"));
@@ -466,45 +541,28 @@ bool OilFillerPose::ofPlaneCal()
     // normal_est.setKSearch(50);
     // normal_est.compute(*cloud_normals);
 
-    std::vector<int> indices(0);
-    pcl::SACSegmentation<pcl::PointXYZ> seg;
-    // pcl::SACSegmentationFromNormals<pcl::PointXYZ, pcl::Normal> seg;
-    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-    pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-    seg.setInputCloud(cloud_of);
-    // seg.setInputNormals(cloud_normals);
-    // seg.setNormalDistanceWeight(0.01);
-    seg.setOptimizeCoefficients(true);
-    seg.setModelType(pcl::SACMODEL_PLANE);
-    seg.setMethodType(pcl::SAC_RANSAC);
-    seg.setDistanceThreshold(0.01);
-    seg.setMaxIterations(100);
-    seg.segment(*inliers, *coefficients);
-    pcl::ExtractIndices<pcl::PointXYZ> extract;
-    pcl::ModelCoefficients::Ptr coefficients_circle(new pcl::ModelCoefficients);
-    static int count = 0;
-    static bool flag = false;
+    pcl::PointIndices::Ptr inliers = workspace_.inliers;
+    pcl::ModelCoefficients::Ptr coefficients = workspace_.plane;
+    workspace_.plane_ransac.setInputCloud(*cloud_of);
+    workspace_.plane_ransac.segment(*inliers, *coefficients);
+    pcl::ModelCoefficients::Ptr coefficients_circle = workspace_.circle;
+    bool circle_found = false;
     if (inliers->indices.size() > 0)
     {
+        // 平面外的点
+        workspace_.complementInliers(cloud_of->size());
 
-        extract.setInputCloud(cloud_of);
-        extract.setIndices(inliers);
-        extract.setNegative(true);
-        extract.filter(indices);
-        // extract.filter(*cloud_oil);
-        inliers->indices = indices;
-
-        if (inliers->indices.size() > 100)
+        if (workspace_.outliers->indices.size() > min_points)
         {
-            // *********** 圆模型
-            seg.setInputCloud(cloud_of);
-            seg.setIndices(inliers);
-            seg.setOptimizeCoefficients(true);
-            seg.setModelType(pcl::SACMODEL_CIRCLE3D);
-            seg.setMethodType(pcl::SAC_RANSAC);
-            seg.setDistanceThreshold(0.01);
-            seg.setMaxIterations(100);
-            seg.segment(*inliers, *coefficients_circle);
+            // *********** 圆模型: 投影到平面内拟合
+            workspace_.circle_fit.setInputCloud(*cloud_of, Eigen::Vector4f(coefficients->values[0], coefficients->values[1],
+                                                                           coefficients->values[2], coefficients->values[3]),
+                                                workspace_.outliers->indices);
+            if (!workspace_.circle_fit.fit(*inliers, *coefficients_circle))
+            {
+                printf("[Erro] Circle fitting failed!\n");
+                return false;
+            }
 
             // // *********** 圆柱模型
             // seg.setInputCloud(cloud_of);
@@ -536,47 +594,59 @@ bool OilFillerPose::ofPlaneCal()
             //     visualizer2->spinOnce(10);
             // }
 
-            pcl::PointXYZ center_point;
-            center_point.x = coefficients_circle->values[0];
-            center_point.y = coefficients_circle->values[1];
-            center_point.z = coefficients_circle->values[2];
             std::cout << *coefficients_circle << std::endl;
-            trans_buff_.col(count++) << coefficients_circle->values[0], coefficients_circle->values[1], coefficients_circle->values[2];
-            if (count >= buff_size_)
-            {
-                flag = true;
-                count = 0;
-            }
 
-            if (flag)
+            if (!acceptFit(f, workspace_.plane_ransac.quality()))
             {
-                trans << trans_buff_.rowwise().mean();
+                return false;
             }
+            circle_found = true;
         }
     }
 
     std::cout << "平面局内点数：" << inliers->indices.size() << std::endl;
-    if (inliers->indices.size() < 100)
+    if (inliers->indices.size() < min_points)
     { // TODO:阈值可根据平面距离调整
         printf("[Erro] Too few points in cloud_of!\n");
         return false;
     }
-
-    coef[0] = coefficients->values[0];
-    coef[1] = coefficients->values[1];
-    coef[2] = coefficients->values[2];
-    coef[3] = coefficients->values[3];
+    if (!circle_found)
+    {
+        printf("[Erro] Too few points off the plane!\n");
+        return false;
+    }
 
     std::cout << "平面参数:\n"
-              << coef << std::endl; // 平面方程参数
+              << f.coef << std::endl; // 平面方程参数
 
     return true;
 }
 
-void OilFillerPose::ofCenterCal()
+bool OilFillerPose::acceptFit(PoseFrame &f, const PlaneRansac::Quality &plane_quality)
 {
-    const float coef_x = receiver->getLookupX().at<float>(0, of_center.x); // 像素点与世界点x方向映射关系
-    const float coef_y = receiver->getLookupY().at<float>(0, of_center.y); // 像素点与世界点y方向映射关系
+    // 质量门限: 由平面与圆拟合残差估计的位置标准差过大时丢弃本帧
+    workspace_.poseCovariance(plane_quality, f.covariance);
+    const double sigma = DetectorWorkspace::positionSigma(f.covariance);
+    printf("[INFO] plane rms %.4f, circle rms %.4f, position sigma %.4f\n", plane_quality.rms,
+           workspace_.circle_fit.quality().rms, sigma);
+    if (sigma > max_position_sigma_)
+    {
+        printf("[WARN] Position sigma %.4f exceeds %.4f, frame skipped\n", sigma, max_position_sigma_);
+        return false;
+    }
+
+    // 单帧量测, 由 ofTrack 滤波
+    const std::vector<float> &plane = workspace_.plane->values, &circle = workspace_.circle->values;
+    f.trans << circle[0], circle[1], circle[2];
+    f.radius = circle[3];
+    f.coef << plane[0], plane[1], plane[2], plane[3];
+    return true;
+}
+
+void OilFillerPose::ofCenterCal(PoseFrame &f)
+{
+    const float coef_x = f.lookup_x.at<float>(f.center.y, f.center.x); // 像素点与世界点x方向映射关系(已去畸变)
+    const float coef_y = f.lookup_y.at<float>(f.center.y, f.center.x); // 像素点与世界点y方向映射关系(已去畸变)
 
     std::cout << "coeff_x:" << coef_x << "\ncoeff_y:" << coef_y << std::endl;
 
@@ -592,7 +662,7 @@ void OilFillerPose::ofCenterCal()
     // a*coeff_x*z+b*coeff_y*z+c*z+d = 0
     // z = -d/(a*coeff_x+b*coeff_y+c)
 
-    const float a = coef[0], b = coef[1], c = coef[2], d = coef[3];
+    const float a = f.coef[0], b = f.coef[1], c = f.coef[2], d = f.coef[3];
 
     float z = -d / (a * coef_x + b * coef_y + c);
     float x = coef_x * z;
@@ -600,13 +670,13 @@ void OilFillerPose::ofCenterCal()
 
     // trans << x, y, z; // 记录加油口坐标系平移矩阵
     cout << "trans =\n"
-         << trans << endl;
+         << f.trans << endl;
 }
 
-void OilFillerPose::ofPoseCal()
+void OilFillerPose::ofPoseCal(PoseFrame &f)
 {
-    double angle_y = atan(coef[0] / coef[2]); // 弧度(-pi/2,pi/2) atan(x/z) 法向量在xz平面投影与z轴夹角
-    double angle_x = atan(coef[1] / coef[2]); // 弧度(-pi/2,pi/2) atan(y/z) 法向量在xy平面投影与z轴夹角
+    double angle_y = atan(f.coef[0] / f.coef[2]); // 弧度(-pi/2,pi/2) atan(x/z) 法向量在xz平面投影与z轴夹角
+    double angle_x = atan(f.coef[1] / f.coef[2]); // 弧度(-pi/2,pi/2) atan(y/z) 法向量在xy平面投影与z轴夹角
                                               //    printf("angle_x:%f rad  angle_y:%f rad", angle_x, angle_y);
 
     // 绕y轴旋转angle_y, 则法向量在xz平面投影与旋转后的z轴重合
@@ -618,7 +688,7 @@ void OilFillerPose::ofPoseCal()
     Eigen::Matrix3d rot_matrix_x = rot_vector_x.matrix();
 
     // 原始坐标系分别绕x轴和y轴旋转后, 使z轴与平面法向量平行, 作为中心点处坐标系
-    rot_matrix = rot_matrix_x * rot_matrix_y;
+    f.rot = rot_matrix_x * rot_matrix_y;
 
     // Eigen::Quaterniond q;
     // q.x() = 0.771307765909;
@@ -628,10 +698,45 @@ void OilFillerPose::ofPoseCal()
     // rot_matrix = q.toRotationMatrix();
 
     cout << "rot_matrix =\n"
-         << rot_matrix << endl;
+         << f.rot << endl;
+}
+
+bool OilFillerPose::ofTrack(PoseFrame &f)
+{
+    std::lock_guard<std::mutex> guard(pose_lock_);
+    const double t = f.stamp.toSec();
+    if (f.verified)
+    {
+        pose_tracker_.coast(t);
+    }
+    else
+    {
+        if (!pose_tracker_.update(t, f.trans, f.rot, f.covariance))
+        {
+            return false;
+        }
+
+        // 圆心在平面之上的高度(沿姿态 z 轴), 与半径一起作为验证用的加油口模型
+        const Eigen::Vector3d n = f.rot.col(2);
+        Eigen::Vector4d plane = f.coef.cast<double>();
+        plane /= plane.head<3>().norm();
+        if (plane.head<3>().dot(n) < 0)
+        {
+            plane = -plane;
+        }
+        const double height = n.dot(f.trans) + plane[3];
+
+        Eigen::Vector3d position;
+        Eigen::Matrix3d rotation;
+        pose_tracker_.getPose(position, rotation);
+        pose_tracker_.calibrate(*f.cloud, Pinhole::fromLookup(f.lookup_x, f.lookup_y), position, rotation, f.radius, (float)height);
+    }
+    pose_tracker_.getPose(f.trans, f.rot, f.covariance);
+    f.posed = true;
+    return true;
 }
 
-void OilFillerPose::ofPoseShow(pcl::visualization::PCLVisualizer::Ptr &visualizer)
+void OilFillerPose::ofPoseShow(pcl::visualization::PCLVisualizer::Ptr &visualizer, const ShowSnapshot &snap)
 {
 
     // 显示平面
@@ -663,48 +768,221 @@ void OilFillerPose::ofPoseShow(pcl::visualization::PCLVisualizer::Ptr &visualize
 
     // 显示中心点位置
     pcl::PointXYZ center_point;
-    center_point.x = trans[0];
-    center_point.y = trans[1];
-    center_point.z = trans[2];
+    center_point.x = snap.trans[0];
+    center_point.y = snap.trans[1];
+    center_point.z = snap.trans[2];
     visualizer->addSphere(center_point, 0.005, 0.0, 1.0, 0.0, "sphere");
 
     // 显示加油口姿态
-    plotFrame(visualizer, trans, rot_matrix, "frame", 0.06);
+    plotFrame(visualizer, snap.trans, snap.rot, "frame", 0.06);
 }
 
 void OilFillerPose::run(int loop_rate)
 {
-    ros::Rate rate(loop_rate); // 与采集频率接近即可
-    while (ros::ok())
+    if (pipeline_)
     {
-        pcl::copyPointCloud(*receiver->getCloud(), *cloud); // copy原始点云
+        runPipeline(loop_rate);
+    }
+    else
+    {
+        runSerial(loop_rate);
+    }
 
-        if (ofDetect() && ofPlaneCal())
-        {                  // 检测到加油口, 平面拟合成功
-            ofCenterCal(); // 加油口中心坐标计算
-            ofPoseCal();   // 加油口姿态解算
-            publishTF();   // 发布加油口姿态
-        }
+    printf("[INFO] Exit oil filter detector...\n");
+    printf("[INFO] Frames processed: %lu, idle waits (redundant iterations avoided): %lu, reprocessed: %lu\n",
+           (unsigned long)processed_, (unsigned long)receiver->getStats().idle, (unsigned long)receiver->getStats().reprocessed);
+    receiver->stop();
+}
 
+void OilFillerPose::spinOnce()
+{
+    if (callback_queue_)
+    {
+        callback_queue_->callAvailable();
+    }
+    else
+    {
         ros::spinOnce();
-        rate.sleep();
     }
+}
 
-    printf("[INFO] Exit oil filter detector...\n");
-    receiver->stop();
+void OilFillerPose::runSerial(int loop_rate)
+{
+    // 按帧序号驱动: 只处理新到的帧, 等待超时(约一个采集周期)时不重复处理旧帧
+    const std::chrono::milliseconds timeout(std::max(1000 / std::max(loop_rate, 1), 1));
+    while (ros::ok() && !quit_)
+    {
+        const CloudFramePtr source = receiver->waitForFrame(frame_.seq, timeout);
+        if (!source)
+        {
+            spinOnce();
+            continue;
+        }
+        grabFrame(frame_, source); // 借用当前层点云
+
+        // 跟踪预测验证通过, 或检测到加油口且平面拟合成功
+        if ((ofVerify(frame_) || ofDetect(frame_)) && (frame_.verified || ofPlaneCal(frame_)))
+        {
+            if (!frame_.verified)
+            {
+                ofCenterCal(frame_); // 加油口中心坐标计算
+                ofPoseCal(frame_);   // 加油口姿态解算
+            }
+            if (ofTrack(frame_))
+            {
+                publishTF(frame_); // 发布加油口姿态
+            }
+        }
+        showFrame(frame_);
+
+        spinOnce();
+    }
+}
+
+void OilFillerPose::runPipeline(int loop_rate)
+{
+    // 采集 -> 2D检测(验证或霍夫) -> 3D拟合(RANSAC 与跟踪滤波) -> 发布, 每级一个线程, 相邻两级之间为只保留最新帧的槽:
+    // 第 N+1 帧的圆检测与第 N 帧的平面/圆拟合同时进行, 吞吐量取决于最慢的一级;
+    // 后级来不及处理时旧帧被覆盖, 每级最多积压一帧, 延迟有界
+    LatestSlot<PoseFrame> detect_slot, fit_slot, publish_slot;
+    const std::chrono::milliseconds timeout(std::max(1000 / std::max(loop_rate, 1), 1));
+
+    // 采集: 按帧序号等待新帧并借用接收器的只读帧, 同一帧不会被处理两次;
+    // 每次 put/丢弃后立即 release, 被覆盖的旧帧尽早回到接收器的缓存池
+    std::thread grab_thread([&]() {
+        PoseFrame f;
+        uint64_t seq = 0;
+        while (ros::ok() && !detect_slot.closed())
+        {
+            const CloudFramePtr source = receiver->waitForFrame(seq, timeout);
+            if (!source)
+            {
+                continue;
+            }
+            seq = source->seq;
+            grabFrame(f, source);
+            detect_slot.put(f);
+            f.release();
+        }
+    });
+
+    std::thread detect_thread([&]() {
+        PoseFrame f;
+        while (!detect_slot.closed())
+        {
+            if (!detect_slot.take(f, timeout))
+            {
+                continue;
+            }
+            if (ofVerify(f) || ofDetect(f))
+            {
+                fit_slot.put(f);
+            }
+            else
+            {
+                showFrame(f); // 未检测到, 该帧到此结束
+            }
+            f.release();
+        }
+    });
+
+    std::thread fit_thread([&]() {
+        PoseFrame f;
+        while (!fit_slot.closed())
+        {
+            if (!fit_slot.take(f, timeout))
+            {
+                continue;
+            }
+            if (f.verified || ofPlaneCal(f))
+            {
+                if (!f.verified)
+                {
+                    ofCenterCal(f);
+                    ofPoseCal(f);
+                }
+                ofTrack(f);
+            }
+            showFrame(f);
+            if (f.posed)
+            {
+                f.release(); // 发布只需要位姿
+                publish_slot.put(f);
+            }
+            f.release();
+        }
+    });
+
+    // 发布在调用线程, 同时处理 ROS 回调
+    PoseFrame f;
+    while (ros::ok() && !quit_)
+    {
+        if (publish_slot.take(f, timeout))
+        {
+            publishTF(f);
+        }
+        spinOnce();
+    }
+
+    detect_slot.close();
+    fit_slot.close();
+    publish_slot.close();
+    grab_thread.join();
+    detect_thread.join();
+    fit_thread.join();
+
+    printf("[INFO] Pipeline dropped frames: detect %lu, fit %lu, publish %lu\n", (unsigned long)detect_slot.dropped(),
+           (unsigned long)fit_slot.dropped(), (unsigned long)publish_slot.dropped());
+}
+
+void OilFillerPose::showFrame(const PoseFrame &f)
+{
+    if (!running)
+    {
+        return; // 未显示时不发布快照, 检测路径与 run() 完全相同
+    }
+
+    // 只复制指针与位姿, 图像与点云仍借用接收器的只读帧
+    auto snap = std::make_shared<ShowSnapshot>();
+    snap->seq = f.seq;
+    snap->stamp = f.stamp;
+    snap->processed = processed_;
+    snap->source = f.source;
+    snap->color = f.color;
+    snap->cloud = f.cloud;
+    snap->detected = f.detected;
+    snap->verified = f.verified;
+    snap->posed = f.posed;
+    snap->rect = f.rect;
+    snap->center = f.center;
+    snap->pixel_radius = f.pixel_radius;
+    snap->trans = f.trans;
+    snap->rot = f.rot;
+
+    std::lock_guard<std::mutex> guard(show_lock_);
+    if (!show_snapshot_ || show_snapshot_->seq < snap->seq) // 流水线中2D检测级与3D拟合级都会发布, 只保留较新的帧
+    {
+        show_snapshot_ = std::move(snap);
+    }
 }
 
 void OilFillerPose::runShow(int loop_rate)
 {
     running = true;
-    // 启动图像显示线程
-    auto imageViewerThread = std::thread(&OilFillerPose::imageViewer, this, loop_rate);
-    imageViewerThread.detach(); // 将子线程从主线程里分离
-
-    // 启动图像显示线程
-    auto cloudViewerThread = std::thread(&OilFillerPose::cloudViewer, this, loop_rate);
-    cloudViewerThread.detach(); // 将子线程从主线程里分离
+    // 显示线程按 show_rate_ 读取最新的结果快照, 不参与检测
+    std::thread image_viewer_thread(&OilFillerPose::imageViewer, this, show_rate_);
+    std::thread cloud_viewer_thread(&OilFillerPose::cloudViewer, this, show_rate_);
 
     cout << "[info]"
          << "show thread is started" << endl;
+
+    // 检测在调用线程以采集频率运行, 与不显示时相同
+    run(loop_rate);
+
+    running = false;
+    image_viewer_thread.join();
+    cloud_viewer_thread.join();
+
+    std::lock_guard<std::mutex> guard(show_lock_);
+    show_snapshot_.reset();
 }
@@ -11,6 +11,8 @@
 #include <pcl/features/normal_3d.h>
 #include <pcl/filters/extract_indices.h>
 
+#include "fusion/utils.h"
+
 void setPose(geometry_msgs::Pose &pose, double x, double y, double z, double roll, double pitch, double yaw)
 {
     pose.position.x = x;
@@ -33,6 +35,7 @@ OilDetectTsdf::OilDetectTsdf(std::shared_ptr<CameraReceiver> img_receiver,
       tsdf_data_floder_(root_floder), fusion_(new TsdfFusion)
 {
     img_receiver->run();
+    oil_rough_detecter_.setFocalLength(CircleTracker::focalFromLookup(img_receiver->getLookupX()));
 
     init_target_x_ = 0;
     init_target_y_ = 0;
@@ -47,6 +50,14 @@ OilDetectTsdf::OilDetectTsdf(std::shared_ptr<CameraReceiver> img_receiver,
 
 OilDetectTsdf::~OilDetectTsdf()
 {
+    show_running_ = false;
+    if (image_viewer_thread_.joinable())
+        image_viewer_thread_.join();
+    if (cloud_viewer_thread_.joinable())
+        cloud_viewer_thread_.join();
+
+    // 取消订阅, 之后不再有回调访问接收器
+    img_receiver_->stop();
 }
 
 int OilDetectTsdf::run()
@@ -68,14 +79,30 @@ int OilDetectTsdf::run()
          << "初步定位...！" << endl;
     float rough_pos[3] = {init_target_x_, init_target_y_, init_target_z_};
 
+    // 每次尝试并行评估多个候选圆, 失败后等待下一帧点云再试, 不再固定休眠;
+    // 彩色图、深度图、点云与时间戳取自同一转换帧, 霍夫圆与其三维位置对应同一时刻
     int count = 0;
-    while (is_ok != 0 && count++ < 100)
+    CloudFramePtr frame = img_receiver_->getFrame();
+    while (is_ok != 0 && count++ < 100 && ros::ok())
     {
-        is_ok = oil_rough_detecter_.detect_once(img_receiver_->getColor(),
-                                                img_receiver_->getDepth(),
-                                                img_receiver_->getCloud(), rough_pos);
-        ros::Duration(1).sleep();
+        if (!frame)
+        {
+            frame = img_receiver_->waitForFrame(0, std::chrono::milliseconds(1000));
+            continue;
+        }
+        const CloudLevel &base = frame->levels[0];
+        is_ok = oil_rough_detecter_.detect_once(base.color, base.depth, base.cloud, rough_pos, frame->stamp);
+        if (is_ok != 0)
+        {
+            // 超时则用同一帧重试
+            CloudFramePtr next = img_receiver_->waitForFrame(frame->seq, std::chrono::milliseconds(1000));
+            if (next)
+            {
+                frame = next;
+            }
+        }
     }
+    frame.reset();
     if (is_ok != 0)
     {
         cout << "[error] "
@@ -97,28 +124,54 @@ int OilDetectTsdf::run()
         return 2;
     }
 
-    // 三维重建
+    // 三维重建; 体素精定位时不导出 ply
     cout << "[info] "
          << "三维重建...！" << endl;
-    fusion_->fusion(tsdf_folder, multi_num, rough_pos, ply_path);
+    fusion_->fusion(tsdf_folder, multi_num, rough_pos, volume_detect_ ? "" : ply_path);
 
-    // 精定位
+    // 精定位: 优先直接查询融合体素
     cout << "[info] "
          << "精定位...！" << endl;
-    pcl::PointCloud<pcl::PointXYZ>::Ptr tsdf_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::io::loadPLYFile(ply_path, *tsdf_cloud);
-    is_ok = oil_accurate_detecter_.detect_once(tsdf_cloud);
-    oil_accurate_detecter_.saveDataFrame(tsdf_folder + "/accurate_detecter", "0");
+    is_ok = -1;
+    const TsdfVolume *volume = fusion_->getVolume();
+    if (volume_detect_ && volume != nullptr)
+    {
+        is_ok = oil_volume_detecter_.detect_once(*volume, rough_pos);
+        oil_volume_detecter_.saveDataFrame(tsdf_folder + "/volume_detecter", "0");
+        if (is_ok == 0)
+        {
+            oil_pos_ = oil_volume_detecter_.getPosition();
+            oil_quat_ = oil_volume_detecter_.getQuaternion();
+            oil_cov_ = oil_volume_detecter_.getCovariance();
+        }
+        else
+        {
+            cout << "[warn] "
+                 << "体素精定位失败, 导出点云重试！" << endl;
+            SaveVoxelGrid2SurfacePointCloud(ply_path, volume->dim_x, volume->dim_y, volume->dim_z, volume->voxel_size,
+                                            volume->origin[0], volume->origin[1], volume->origin[2],
+                                            volume->tsdf.data(), volume->weight.data(), 0.2f, 0.0f, volume->base2world);
+        }
+    }
 
     if (is_ok != 0)
     {
-        cout << "[error] "
-             << "精定位失败！" << endl;
-        return 3;
-    }
+        pcl::PointCloud<pcl::PointXYZ>::Ptr tsdf_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+        pcl::io::loadPLYFile(ply_path, *tsdf_cloud);
+        is_ok = oil_accurate_detecter_.detect_once(tsdf_cloud);
+        oil_accurate_detecter_.saveDataFrame(tsdf_folder + "/accurate_detecter", "0");
 
-    oil_pos_ = oil_accurate_detecter_.getPosition();
-    oil_quat_ = oil_accurate_detecter_.getQuaternion();
+        if (is_ok != 0)
+        {
+            cout << "[error] "
+                 << "精定位失败！" << endl;
+            return 3;
+        }
+
+        oil_pos_ = oil_accurate_detecter_.getPosition();
+        oil_quat_ = oil_accurate_detecter_.getQuaternion();
+        oil_cov_ = oil_accurate_detecter_.getCovariance();
+    }
 
     tf::Quaternion quat(oil_quat_[0], oil_quat_[1], oil_quat_[2], oil_quat_[3]);
     tf::Matrix3x3 rota(quat);
@@ -242,7 +295,7 @@ void OilDetectTsdf::imageViewer(int loop_rate)
     ros::Rate rate(loop_rate);
     bool running = true;
     size_t frameCount = 0;
-    for (; running && ros::ok();)
+    for (; running && show_running_ && ros::ok();)
     {
         ++frameCount;
         now = std::chrono::high_resolution_clock::now();
@@ -255,7 +308,13 @@ void OilDetectTsdf::imageViewer(int loop_rate)
             start = now;
             frameCount = 0;
         }
-        auto color_draw = img_receiver_->getColor().clone();
+        // 借用接收器最新转换的一帧, 持有期间不会被改写
+        const CloudFramePtr frame = img_receiver_->getFrame();
+        cv::Mat color_draw;
+        if (frame)
+        {
+            color_draw = frame->levels[0].color.clone();
+        }
         if (!color_draw.empty())
         {
             cv::Mat color_show(color_draw);
@@ -297,11 +356,15 @@ void OilDetectTsdf::cloudViewer(int loop_rate)
     visualizer->setCameraPosition(0, 0, 0, 0, -1, 0);
 
     ros::Rate rate(loop_rate); // 与采集频率接近即可
-    while (ros::ok() && !visualizer->wasStopped())
+    while (ros::ok() && show_running_ && !visualizer->wasStopped())
     {
         visualizer->removeAllShapes();
 
-        pcl::copyPointCloud(*img_receiver_->getCloud(), *cloud); // copy原始点云
+        const CloudFramePtr frame = img_receiver_->getFrame();
+        if (frame)
+        {
+            pcl::copyPointCloud(*frame->levels[0].cloud, *cloud); // copy原始点云
+        }
 
         // 更新点云显示
         visualizer->updatePointCloud(cloud, cloudName);
@@ -312,13 +375,17 @@ void OilDetectTsdf::cloudViewer(int loop_rate)
 
 void OilDetectTsdf::show(int loop_rate)
 {
+    if (show_running_)
+    {
+        return;
+    }
+    show_running_ = true;
+
     // 启动图像显示线程
-    std::thread image_viewer_thread = std::thread(&OilDetectTsdf::imageViewer, this, loop_rate);
-    image_viewer_thread.detach(); // 将子线程从主线程里分离
+    image_viewer_thread_ = std::thread(&OilDetectTsdf::imageViewer, this, loop_rate);
 
     // 启动点云显示线程
-    std::thread cloud_viewer_thread = std::thread(&OilDetectTsdf::cloudViewer, this, loop_rate);
-    cloud_viewer_thread.detach(); // 将子线程从主线程里分离
+    cloud_viewer_thread_ = std::thread(&OilDetectTsdf::cloudViewer, this, loop_rate);
 
     printf("[INFO] show image and cloud...\n");
 }
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include <fstream>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
 
 #include "oil_detect/oil_rough_detect.h"
 
@@ -7,11 +10,11 @@
 #include <pcl/filters/extract_indices.h>
 #include <pcl/keypoints/uniform_sampling.h>
 
-#include <tf/transform_listener.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <tf2/transform_datatypes.h>
 
-OilRoughDetect::OilRoughDetect(std::string color_frame) : color_frame_(color_frame), cloud_(new PCLPointCloudRGB)
+OilRoughDetect::OilRoughDetect(std::string color_frame, std::shared_ptr<TfBufferService> tf_buffer)
+    : color_frame_(color_frame), tf_buffer_(std::move(tf_buffer)), cloud_(new PCLPointCloudRGB)
 {
 }
 
@@ -19,10 +22,12 @@ OilRoughDetect::~OilRoughDetect()
 {
 }
 
-int OilRoughDetect::detect_once(const cv::Mat &color, const cv::Mat &depth, const PCLPointCloudRGB::Ptr cloud, float *oil_pose)
+int OilRoughDetect::detect_once(const cv::Mat &color, const cv::Mat &depth, const PCLPointCloudRGB::Ptr cloud, float *oil_pose,
+                                const ros::Time &stamp)
 {
+    stamp_ = stamp;
     color_ = color;
-    color_draw_ = color_.clone();
+    color_.copyTo(color_draw_); // 尺寸不变时复用缓存
     depth_ = depth;
     cloud_ = cloud;
 
@@ -89,148 +94,210 @@ void OilRoughDetect::saveDataFrame(const std::string save_folder, const std::str
 
 int OilRoughDetect::roiDetect()
 {
-    // 均值滤波
-    cv::Mat img_blur;
-    blur(color_, img_blur, cv::Size(10, 10));
-
-    // 灰度转换
-    cv::Mat img_gray;
-    cvtColor(img_blur, img_gray, cv::COLOR_BGR2GRAY);
-
-    // 霍夫变换圆检测
-    // 参数:      默认, 最小间距, canny上限, 阈值(越大越圆), 最小半径, 最大半径
-    std::vector<cv::Vec3f> circles;
-    cv::HoughCircles(img_gray, circles, cv::HOUGH_GRADIENT, 1, 1, 80, 30, 40, 200); // 这里的canny算法下限自动设置为上限一半
-
-    if (circles.empty())
+    // 霍夫变换圆检测, 取得分最高的若干候选, 有可信的上次结果时其附近窗口的结果排在最前
+    tracker_.setDepthPrior(depth_.size() == color_.size() ? depth_ : cv::Mat(), fx_);
+    if (!tracker_.detectCandidates(color_, 1, num_candidates_, candidates_))
     {
         std::cout << "[OilRoughDetect] Detect 0 circles!" << std::endl;
         return -1;
     }
 
-    // 查找最大圆
-    std::vector<double> radius_vec;
-    int max_r_index = 0;
-    double max_r = 0;
-    for (int i = 0; i < circles.size(); i++)
+    std::cout << "[OilRoughDetect] 候选圆个数 " << candidates_.size() << std::endl;
+    return 0;
+}
+
+cv::Rect OilRoughDetect::candidateRoi(const CircleDetection &circle_det) const
+{
+    // 放大圆形区域为矩形框
+    const cv::Point center(cvRound(circle_det.center.x), cvRound(circle_det.center.y));
+    const int radius_zoom = (int)(cvRound(circle_det.radius) * 2);
+    return cv::Rect(center.x - radius_zoom, center.y - radius_zoom, 2 * radius_zoom, 2 * radius_zoom) &
+           cv::Rect(0, 0, color_.cols, color_.rows);
+}
+
+void OilRoughDetect::evaluateCandidate(const CircleDetection &circle_det, DetectorWorkspace &workspace, CandidateResult &result) const
+{
+    result.valid = false;
+    result.roi = candidateRoi(circle_det);
+    if (result.roi.area() == 0)
     {
-        double radius = cvRound(circles[i][2]);
-        radius_vec.push_back(radius);
+        return;
+    }
 
-        if (radius > max_r)
+    /// 获取加油口无组织无色彩点云, 跳过无效点; 缓存按 ROI 大小预留, 多帧复用
+    workspace.reserve(result.roi.area());
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_tmp = workspace.cloud;
+    cloud_tmp->points.clear();
+    for (int row = result.roi.y; row < result.roi.y + result.roi.height; row++)
+    {
+        for (int col = result.roi.x; col < result.roi.x + result.roi.width; col++)
         {
-            max_r = radius;
-            max_r_index = i;
+            const pcl::PointXYZRGBA &p_in = cloud_->points[row * cloud_->width + col];
+            if (!std::isfinite(p_in.z))
+                continue;
+            cloud_tmp->points.push_back(pcl::PointXYZ(p_in.x, p_in.y, p_in.z));
         }
     }
+    cloud_tmp->width = cloud_tmp->points.size();
+    cloud_tmp->height = 1;
+    if (cloud_tmp->points.size() < 100)
+    {
+        return;
+    }
 
-    std::cout << "[OilRoughDetect] 最大圆半径是 " << max_r << ", 索引是 " << max_r_index << std::endl;
+    /// 平面拟合 // 平面方程: ax+by+cz+d = 0
+    pcl::PointIndices::Ptr inliers = workspace.inliers;
+    workspace.plane_ransac.setInputCloud(*cloud_tmp);
+    workspace.plane_ransac.segment(*inliers, *workspace.plane);
 
-    cv::Point center(cvRound(circles[max_r_index][0]), cvRound(circles[max_r_index][1]));
-    double radius = cvRound(circles[max_r_index][2]);
+    result.inliers = inliers->indices.size();
+    if (result.inliers < 100)
+    {
+        return;
+    }
 
-    // 绘制圆心与轮廓
-    circle(color_draw_, center, 4, cv::Scalar(0, 255, 0), -1, 8, 0);
-    circle(color_draw_, center, (int)radius, cv::Scalar(0, 0, 255), 2, 8, 0);
+    // 计算平面内点的均值坐标，相对于像极坐标系
+    computerMeanValue(cloud_tmp, inliers->indices, result.pos);
+
+    // 边缘一致性: 平面外的点中须有一整圈半径与加油口一致的圆孔边缘(半径先验见 getPosFromRoi),
+    // 平坦区域上误检的霍夫圆没有这样的边缘
+    const float physical_radius = 0.0415f;
+    const float tolerance = kRadiusTolerance * physical_radius;
+    workspace.complementInliers(cloud_tmp->size());
+    if ((int)workspace.outliers->indices.size() < kMinRimPoints)
+    {
+        return;
+    }
+    const std::vector<float> &plane = workspace.plane->values;
+    workspace.circle_fit.setInputCloud(*cloud_tmp, Eigen::Vector4f(plane[0], plane[1], plane[2], plane[3]),
+                                       workspace.outliers->indices);
+    pcl::PointIndices rim;
+    if (!workspace.circle_fit.fit(rim, *workspace.circle) || (int)rim.indices.size() < kMinRimPoints ||
+        !isClosedRim(*cloud_tmp, workspace.outliers->indices, rim.indices, *workspace.circle,
+                     workspace.circle_fit.params().distance_threshold))
+    {
+        return;
+    }
+    result.rim_points = rim.indices.size();
+    result.rim_radius = workspace.circle->values[3];
+    float rim_score = 1.0f - 0.5f * std::abs(result.rim_radius - physical_radius) / tolerance;
 
-    // 放大圆形区域为矩形框
-    int radius_zoom = (int)(radius * 2);
-    int x = std::max(center.x - radius_zoom, 0);
-    int y = std::max(center.y - radius_zoom, 0);
-    int w = std::min(2 * radius_zoom, 640 - x);
-    int h = std::min(2 * radius_zoom, 480 - y);
-    cv::Rect rect(x, y, w, h);
-    cv::rectangle(color_draw_, rect, cvScalar(0, 255, 255), 2, 8, 0);
-
-    if (rect.x < 0 || rect.x > color_.cols || rect.y < 0 || rect.y > color_.rows)
+    // 有焦距时像素半径换算的物理半径也须在容差内
+    if (fx_ > 0 && result.pos[2] > 0)
     {
-        std::cout << "[OilRoughDetect] [error] Bad rect!" << std::endl;
-        return -1;
+        const float radius_m = circle_det.radius * result.pos[2] / fx_;
+        const float error = std::abs(radius_m - physical_radius);
+        if (error > tolerance)
+        {
+            return;
+        }
+        rim_score *= 1.0f - 0.5f * error / tolerance;
     }
+    const float inlier_ratio = (float)result.inliers / cloud_tmp->points.size();
 
-    oil_roi_ = rect;
+    result.score = circle_det.score * inlier_ratio * rim_score;
+    result.valid = true;
+}
 
-    return 0;
+bool OilRoughDetect::isClosedRim(const PCLPointCloud &cloud, const std::vector<int> &outliers, const std::vector<int> &rim,
+                                 const pcl::ModelCoefficients &circle, float threshold)
+{
+    // 圆所在平面内的正交基
+    const Eigen::Vector3f center(circle.values[0], circle.values[1], circle.values[2]);
+    const Eigen::Vector3f normal = Eigen::Vector3f(circle.values[4], circle.values[5], circle.values[6]).normalized();
+    const Eigen::Vector3f u = normal.unitOrthogonal();
+    const Eigen::Vector3f v = normal.cross(u);
+
+    // 只覆盖一段圆弧的(如偏心的小孔或平面边角)不是完整的圆孔
+    int sectors[kRimSectors] = {0};
+    for (int idx : rim)
+    {
+        const Eigen::Vector3f d = cloud.points[idx].getVector3fMap() - center;
+        const float angle = std::atan2(d.dot(v), d.dot(u)) + (float)M_PI;
+        sectors[std::min((int)(angle / (2 * M_PI) * kRimSectors), kRimSectors - 1)] = 1;
+    }
+    if (std::accumulate(sectors, sectors + kRimSectors, 0) < kMinRimSectors)
+    {
+        return false;
+    }
+
+    // 比加油口大的凹陷中也能拟合出圆, 但其平面外的点大量落在圆外
+    const float limit = circle.values[3] + threshold;
+    int inside = 0;
+    for (int idx : outliers)
+    {
+        const Eigen::Vector3f d = cloud.points[idx].getVector3fMap() - center;
+        inside += (d - d.dot(normal) * normal).norm() <= limit;
+    }
+    return inside >= kMinInsideRatio * outliers.size();
 }
 
 int OilRoughDetect::getPosFromRoi()
 {
-    /// 获取加油口无组织无色彩点云
-    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_tmp(new pcl::PointCloud<pcl::PointXYZ>);
-    for (int row = oil_roi_.y; row < oil_roi_.y + oil_roi_.height; row++)
+    // 各候选圆并行做 ROI 提取、平面拟合与边缘一致性检查, 每个候选使用各自的缓存
+    std::vector<CandidateResult> &results = results_;
+    results.resize(candidates_.size());
+    if (workspaces_.size() < candidates_.size())
     {
-        for (int col = oil_roi_.x; col < oil_roi_.x + oil_roi_.width; col++)
+        workspaces_.resize(candidates_.size());
+        for (auto &workspace : workspaces_)
         {
-            pcl::PointXYZRGBA p_in = cloud_->points[row * cloud_->width + col];
-            pcl::PointXYZ p_out;
-            p_out.x = p_in.x;
-            p_out.y = p_in.y;
-            p_out.z = p_in.z;
-            cloud_tmp->points.push_back(p_out);
+            // 与原 SACMODEL_PLANE 参数一致(1cm阈值, 100次, 优化系数)
+            workspace.plane_ransac.params().distance_threshold = 0.01f;
+            workspace.plane_ransac.params().max_iterations = 100;
+            workspace.plane_ransac.params().refine = true;
+
+            // 圆孔边缘: 与精检测相同的 1cm 阈值, 半径限制在加油口实际半径的容差内
+            workspace.circle_fit.params().distance_threshold = 0.01f;
+            workspace.circle_fit.params().min_radius = 0.0415f * (1 - kRadiusTolerance);
+            workspace.circle_fit.params().max_radius = 0.0415f * (1 + kRadiusTolerance);
+            workspace.circle_fit.params().max_iterations = 100;
         }
     }
-
-    if (cloud_tmp->points.empty())
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < (int)candidates_.size(); i++)
     {
-        std::cout << "[OilRoughDetect] "
-                  << "[Erro] Cloud_tmp is empty! no point in selected area" << std::endl;
-        return -1;
+        evaluateCandidate(candidates_[i], workspaces_[i], results[i]);
     }
 
-    std::cout << "[OilRoughDetect] "
-              << "cloud_tmp size: " << cloud_tmp->points.size() << std::endl;
-
-    /// 平面拟合 // 平面方程: ax+by+cz+d = 0
-    pcl::SACSegmentation<pcl::PointXYZ> seg;
-    pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
-    pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
-    seg.setInputCloud(cloud_tmp);
-
-    seg.setOptimizeCoefficients(true);
-    seg.setModelType(pcl::SACMODEL_PLANE);
-    seg.setMethodType(pcl::SAC_RANSAC);
-    seg.setDistanceThreshold(0.01);
-    seg.setMaxIterations(100);
-    seg.segment(*inliers, *coefficients);
-
-    if (inliers->indices.size() < 100)
+    int best = -1;
+    for (int i = 0; i < (int)results.size(); i++)
+    {
+        std::cout << "[OilRoughDetect] 候选 " << i << ": 半径 " << candidates_[i].radius << ", 平面局内点数 " << results[i].inliers
+                  << ", 边缘点数 " << results[i].rim_points << ", 边缘半径 " << results[i].rim_radius
+                  << ", 得分 " << results[i].score << (results[i].valid ? "" : " (无效)") << std::endl;
+        if (results[i].valid && (best < 0 || results[i].score > results[best].score))
+        {
+            best = i;
+        }
+    }
+    if (best < 0)
     {
         std::cout << "[OilRoughDetect] "
-                  << "plane point nuw is too less!" << std::endl;
+                  << "no valid candidate!" << std::endl;
         return -1;
     }
-    std::cout << "[OilRoughDetect] "
-              << "平面局内点数：" << inliers->indices.size() << std::endl;
-
-    pcl::PointCloud<pcl::PointXYZ>::Ptr plane(new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::ExtractIndices<pcl::PointXYZ> extract;
-    std::vector<int> indices(0);
-    extract.setInputCloud(cloud_tmp);
-    extract.setIndices(inliers);
-    extract.setNegative(false);
-    extract.filter(indices);
-    // FIXME: 造成程序自动退出，只能使用 extract.filter(indices);方式
-    // extract.filter(*plane);
-
-    // 随机选择点
-    // pcl::PointCloud<pcl::PointXYZ>::Ptr ran_plane(new pcl::PointCloud<pcl::PointXYZ>);
-    // pcl::UniformSampling<pcl::PointXYZ> filter;
-    // filter.setInputCloud(plane);
-    // filter.setRadiusSearch(0.005f);
-    // filter.filter(*ran_plane);
 
-    // 计算平面内点的均值坐标，相对于像极坐标系
-    computerMeanValue(cloud_tmp, indices, oil_pos_in_camera_);
-    // computerMeanValue(plane, oil_pos_in_camera_);  // FIXME:
+    const CircleDetection &circle_det = candidates_[best];
+    tracker_.accept(circle_det, 1);
+    oil_roi_ = results[best].roi;
+    std::copy(results[best].pos, results[best].pos + 3, oil_pos_in_camera_);
+
+    // 绘制圆心与轮廓
+    const cv::Point center(cvRound(circle_det.center.x), cvRound(circle_det.center.y));
+    circle(color_draw_, center, 4, cv::Scalar(0, 255, 0), -1, 8, 0);
+    circle(color_draw_, center, cvRound(circle_det.radius), cv::Scalar(0, 0, 255), 2, 8, 0);
+    cv::rectangle(color_draw_, oil_roi_, cvScalar(0, 255, 255), 2, 8, 0);
 
     //转换到世界坐标系
-    getCameraPose(color_frame_, "base_link");
+    if (!getCameraPose(color_frame_, "base_link", stamp_))
+        return -1;
     convertPosToWorld(oil_pos_in_camera_, oil_pos_in_world_);
 
     return 0;
 }
 
-void OilRoughDetect::computerMeanValue(PCLPointCloud::Ptr cloud, std::vector<int> indices, float *pos)
+void OilRoughDetect::computerMeanValue(const PCLPointCloud::Ptr cloud, const std::vector<int> &indices, float *pos)
 {
     float XData = 0.0, YData = 0.0, ZData = 0.0;
     for (auto idx : indices)
@@ -246,7 +313,7 @@ void OilRoughDetect::computerMeanValue(PCLPointCloud::Ptr cloud, std::vector<int
     pos[2] = ZData / size;
 }
 
-void OilRoughDetect::computerMeanValue(PCLPointCloud::Ptr cloud, float *pos)
+void OilRoughDetect::computerMeanValue(const PCLPointCloud::Ptr cloud, float *pos)
 {
     float XData = 0.0, YData = 0.0, ZData = 0.0;
     for (auto start = cloud->begin(); start != cloud->end(); start++)
@@ -277,12 +344,10 @@ void OilRoughDetect::saveCameraPose(std::string save_path)
     }
 }
 
-void OilRoughDetect::getCameraPose(std::string source_frame, std::string target_frame)
+bool OilRoughDetect::getCameraPose(std::string source_frame, std::string target_frame, const ros::Time &stamp)
 {
-    tf::TransformListener listener;
-
-    listener.waitForTransform(target_frame, source_frame, ros::Time(0), ros::Duration(3));
-    listener.lookupTransform(target_frame, source_frame, ros::Time(0), camera_pose_);
+    // 共享缓存按图像时间戳插值, 仅在缓存尚无数据时等待
+    return tf_buffer_->lookup(target_frame, source_frame, stamp, camera_pose_, ros::Duration(3));
 }
 
 void OilRoughDetect::convertPosToWorld(float *oil_pos_in_camera, float *oil_pos_in_world)
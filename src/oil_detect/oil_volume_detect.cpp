@@ -0,0 +1,328 @@
+#include "oil_detect/oil_volume_detect.h"
+
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+#include <pcl/io/pcd_io.h>
+
+OilVolumeDetect::OilVolumeDetect()
+    : rim_cloud_(new PCLPointCloud), surface_cloud_(new PCLPointCloud), oil_cloud_(new PCLPointCloud)
+{
+    // 零点平面: 1mm阈值, 与 OilAccurateDetect 一致
+    workspace_.plane_ransac.params().distance_threshold = 0.001f;
+    workspace_.plane_ransac.params().refine = true;
+
+    // 边缘点较稀疏(每圈一条射线一个点), 半径先验比点云拟合略宽
+    workspace_.circle_fit.params().distance_threshold = 0.002f;
+    workspace_.circle_fit.params().min_radius = 0.035f;
+    workspace_.circle_fit.params().max_radius = 0.048f;
+    workspace_.circle_fit.params().max_iterations = 500;
+}
+
+OilVolumeDetect::~OilVolumeDetect()
+{
+}
+
+int OilVolumeDetect::detect_once(const TsdfVolume &volume, const float *rough_pos)
+{
+    const auto start = std::chrono::steady_clock::now();
+    if (volume.empty())
+    {
+        std::cout << "[OilVolumeDetect] "
+                  << "volume is empty!" << std::endl;
+        return -1;
+    }
+    volume_ = &volume;
+    base2world_ = Eigen::Map<const Eigen::Matrix<float, 4, 4, Eigen::RowMajor>>(volume.base2world);
+
+    /// 表面零点 -> 平面
+    findZeroCrossings();
+    pcl::PointIndices &inliers = *workspace_.inliers;
+    pcl::ModelCoefficients &plane = *workspace_.plane;
+    workspace_.plane_ransac.setInputCloud(*workspace_.cloud);
+    if (!workspace_.plane_ransac.segment(inliers, plane) || inliers.indices.size() < 100)
+    {
+        std::cout << "[OilVolumeDetect] "
+                  << "plane point nuw is too less! (" << workspace_.cloud->size() << " zero crossings)" << std::endl;
+        return -1;
+    }
+    std::cout << "[OilVolumeDetect] "
+              << "零点数：" << workspace_.cloud->size() << ", 平面局内点数：" << inliers.indices.size() << std::endl;
+
+    // 法向指向相机一侧(base 相机位于原点), 即加油口凸出的一侧
+    Eigen::Vector4f coef(plane.values[0], plane.values[1], plane.values[2], plane.values[3]);
+    coef /= coef.head<3>().norm();
+    if (coef[3] < 0)
+    {
+        coef = -coef;
+    }
+    normal_ = coef.head<3>();
+    plane_origin_ = -coef[3] * normal_;
+    const Eigen::Vector3f ref = std::abs(normal_[0]) < 0.9f ? Eigen::Vector3f::UnitX() : Eigen::Vector3f::UnitY();
+    e1_ = normal_.cross(ref).normalized();
+    e2_ = normal_.cross(e1_);
+
+    /// 粗定位位置投影到平面, 作为射线起点; 之后以拟合的圆心重新发射
+    const Eigen::Vector4f rough_world(rough_pos[0], rough_pos[1], rough_pos[2], 1.0f);
+    const Eigen::Vector3f rough_base = (base2world_.inverse() * rough_world).head<3>() - plane_origin_;
+    float cu = rough_base.dot(e1_), cv = rough_base.dot(e2_);
+
+    pcl::ModelCoefficients &circle = *workspace_.circle;
+    for (int round = 0; round < std::max(params_.rounds, 1); round++)
+    {
+        marchRays(cu, cv);
+        if ((int)rim_cloud_->size() < params_.num_rays / 4)
+        {
+            std::cout << "[OilVolumeDetect] "
+                      << "too few rim points: " << rim_cloud_->size() << std::endl;
+            return -1;
+        }
+        workspace_.circle_fit.setInputCloud(*rim_cloud_, coef);
+        if (!workspace_.circle_fit.fit(inliers, circle))
+        {
+            std::cout << "[OilVolumeDetect] "
+                      << "circle fitting failed!" << std::endl;
+            return -1;
+        }
+        const Eigen::Vector3f center = Eigen::Vector3f(circle.values[0], circle.values[1], circle.values[2]) - plane_origin_;
+        cu = center.dot(e1_);
+        cv = center.dot(e2_);
+        std::cout << "[OilVolumeDetect] "
+                  << "round " << round << ": 边缘点数 " << rim_cloud_->size() << ", 局内点数 " << inliers.indices.size()
+                  << ", 半径 " << circle.values[3] << std::endl;
+    }
+
+    /// 世界坐标系下的位置与姿态, 姿态与 OilAccurateDetect::planeToQuat 一致: z 轴由加油口指向平面
+    const Eigen::Vector4f center_world = base2world_ * Eigen::Vector4f(circle.values[0], circle.values[1], circle.values[2], 1.0f);
+    oil_trans_[0] = center_world[0];
+    oil_trans_[1] = center_world[1];
+    oil_trans_[2] = center_world[2];
+
+    const Eigen::Vector3d z = (base2world_.topLeftCorner<3, 3>() * -normal_).cast<double>().normalized();
+    const Eigen::Vector3d x = z.cross(Eigen::Vector3d(0, 0, 1.0)).normalized();
+    const Eigen::Vector3d y = z.cross(x);
+    Eigen::Matrix3d rot_matrix;
+    rot_matrix.col(0) << x;
+    rot_matrix.col(1) << y;
+    rot_matrix.col(2) << z;
+    const Eigen::Quaterniond quat_eigen(rot_matrix);
+    oil_quat_[0] = quat_eigen.x();
+    oil_quat_[1] = quat_eigen.y();
+    oil_quat_[2] = quat_eigen.z();
+    oil_quat_[3] = quat_eigen.w();
+
+    // 协方差由 base 相机坐标系旋转到世界坐标系
+    double cov_base[36];
+    workspace_.poseCovariance(cov_base);
+    Eigen::Matrix<double, 6, 6> rotation = Eigen::Matrix<double, 6, 6>::Zero();
+    rotation.topLeftCorner<3, 3>() = base2world_.topLeftCorner<3, 3>().cast<double>();
+    rotation.bottomRightCorner<3, 3>() = rotation.topLeftCorner<3, 3>();
+    Eigen::Map<Eigen::Matrix<double, 6, 6, Eigen::RowMajor>> cov_world(oil_cov_);
+    cov_world = rotation * Eigen::Map<const Eigen::Matrix<double, 6, 6, Eigen::RowMajor>>(cov_base) * rotation.transpose();
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[OilVolumeDetect] "
+              << "oil_trans_: " << oil_trans_[0] << "," << oil_trans_[1] << "," << oil_trans_[2] << std::endl;
+    std::cout << "[OilVolumeDetect] "
+              << "oil_quat_: " << oil_quat_[0] << "," << oil_quat_[1] << "," << oil_quat_[2] << "," << oil_quat_[3] << std::endl;
+    std::cout << "[OilVolumeDetect] "
+              << "位置标准差: " << DetectorWorkspace::positionSigma(oil_cov_) << ", 耗时: " << ms << " ms" << std::endl;
+
+    toWorld(*rim_cloud_, *oil_cloud_);
+    return 0;
+}
+
+void OilVolumeDetect::findZeroCrossings()
+{
+    const TsdfVolume &v = *volume_;
+    const int stride = std::max(params_.column_stride, 1);
+    const int nx = (v.dim_x + stride - 1) / stride, ny = (v.dim_y + stride - 1) / stride;
+
+    // 每列的零点位置(体素 z 坐标)与上一个体素的 tsdf, NaN 表示未找到/未观测
+    std::vector<float> &crossing = workspace_.depths;
+    crossing.assign(nx * ny, std::numeric_limits<float>::quiet_NaN());
+    prev_.assign(nx * ny, std::numeric_limits<float>::quiet_NaN());
+
+    // 每个线程处理若干行, 行内按 z 切片顺序访问, 内存连续
+#pragma omp parallel for schedule(dynamic)
+    for (int cy = 0; cy < ny; cy++)
+    {
+        float *row_crossing = &crossing[cy * nx];
+        float *row_prev = &prev_[cy * nx];
+        const int y = cy * stride;
+        int remaining = nx;
+        for (int z = 0; z < v.dim_z && remaining > 0; z++)
+        {
+            const float *tsdf = &v.tsdf[v.index(0, y, z)];
+            const float *weight = &v.weight[v.index(0, y, z)];
+            for (int cx = 0; cx < nx; cx++)
+            {
+                if (!std::isnan(row_crossing[cx]))
+                {
+                    continue;
+                }
+                const int x = cx * stride;
+                if (weight[x] <= 0)
+                {
+                    row_prev[cx] = std::numeric_limits<float>::quiet_NaN();
+                    continue;
+                }
+                const float s = tsdf[x];
+                if (row_prev[cx] > 0 && s <= 0)
+                {
+                    row_crossing[cx] = z - 1 + row_prev[cx] / (row_prev[cx] - s);
+                    remaining--;
+                }
+                row_prev[cx] = s;
+            }
+        }
+    }
+
+    PCLPointCloud &cloud = *workspace_.cloud;
+    cloud.points.clear();
+    cloud.points.reserve(nx * ny);
+    for (int cy = 0; cy < ny; cy++)
+    {
+        for (int cx = 0; cx < nx; cx++)
+        {
+            const float z = crossing[cy * nx + cx];
+            if (std::isnan(z))
+            {
+                continue;
+            }
+            cloud.points.push_back(PCLPoint(v.origin[0] + cx * stride * v.voxel_size,
+                                            v.origin[1] + cy * stride * v.voxel_size,
+                                            v.origin[2] + z * v.voxel_size));
+        }
+    }
+    cloud.width = cloud.points.size();
+    cloud.height = 1;
+}
+
+bool OilVolumeDetect::surfaceHeight(const Eigen::Vector3f &p, float &height) const
+{
+    const TsdfVolume &v = *volume_;
+    const float min_step = 0.5f * v.voxel_size;
+
+    // 从最大高度沿 -normal_ 步进, 步长取当前距离的 0.8 倍(投影 TSDF 沿光轴方向, 略保守)
+    float h = params_.max_height, prev_h = 0, prev_sdf = 0;
+    bool has_prev = false;
+    while (h > -params_.min_height)
+    {
+        const Eigen::Vector3f q = p + h * normal_;
+        float sdf;
+        if (!v.sample(q[0], q[1], q[2], sdf))
+        {
+            if (has_prev)
+            {
+                return false; // 越过截断带进入未观测区域
+            }
+            h -= v.trunc_margin;
+            continue;
+        }
+        if (sdf <= 0)
+        {
+            if (!has_prev)
+            {
+                return false;
+            }
+            height = h + (prev_h - h) * (-sdf) / (prev_sdf - sdf);
+            return true;
+        }
+        prev_h = h;
+        prev_sdf = sdf;
+        has_prev = true;
+        h -= std::max(0.8f * sdf, min_step);
+    }
+    return false;
+}
+
+void OilVolumeDetect::marchRays(float cu, float cv)
+{
+    const int num_rays = std::max(params_.num_rays, 3);
+    const float step = volume_->voxel_size;
+    rim_u_.assign(num_rays, std::numeric_limits<float>::quiet_NaN());
+    rim_v_.resize(num_rays);
+    rim_h_.resize(num_rays);
+
+    // 每条射线由内向外, 记录最外侧一次表面高度从加油口范围跌落的位置
+#pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < num_rays; k++)
+    {
+        const float theta = 2.0f * (float)M_PI * k / num_rays;
+        const float du = std::cos(theta), dv = std::sin(theta);
+        bool prev_known = false, prev_high = false;
+        float prev_r = 0, prev_h = 0;
+        for (float r = step; r <= params_.max_ray_length; r += step)
+        {
+            const float u = cu + r * du, v = cv + r * dv;
+            float h;
+            if (!surfaceHeight(plane_origin_ + u * e1_ + v * e2_, h))
+            {
+                continue; // 加油口内部无表面, 或紧贴侧壁处有未观测的角点
+            }
+            const bool high = h >= params_.min_height && h <= params_.max_height;
+            if (prev_known && prev_high && !high && r - prev_r <= 4 * step)
+            {
+                const float r_edge = 0.5f * (prev_r + r);
+                rim_u_[k] = cu + r_edge * du;
+                rim_v_[k] = cv + r_edge * dv;
+                rim_h_[k] = prev_h;
+            }
+            prev_known = true;
+            prev_high = high;
+            prev_r = r;
+            prev_h = h;
+        }
+    }
+
+    rim_cloud_->points.clear();
+    for (int k = 0; k < num_rays; k++)
+    {
+        if (std::isnan(rim_u_[k]))
+        {
+            continue;
+        }
+        const Eigen::Vector3f p = plane_origin_ + rim_u_[k] * e1_ + rim_v_[k] * e2_ + rim_h_[k] * normal_;
+        rim_cloud_->points.push_back(PCLPoint(p[0], p[1], p[2]));
+    }
+    rim_cloud_->width = rim_cloud_->points.size();
+    rim_cloud_->height = 1;
+}
+
+void OilVolumeDetect::toWorld(const PCLPointCloud &in, PCLPointCloud &out) const
+{
+    out.points.resize(in.points.size());
+    for (size_t i = 0; i < in.points.size(); i++)
+    {
+        const Eigen::Vector4f p = base2world_ * Eigen::Vector4f(in.points[i].x, in.points[i].y, in.points[i].z, 1.0f);
+        out.points[i] = PCLPoint(p[0], p[1], p[2]);
+    }
+    out.width = out.points.size();
+    out.height = 1;
+}
+
+void OilVolumeDetect::saveDataFrame(const std::string save_folder, const std::string save_num)
+{
+    if (!boost::filesystem::exists(save_folder))
+    {
+        std::cout << "[main] mkdir :" << save_folder << std::endl;
+        boost::filesystem::create_directories(save_folder);
+    }
+
+    toWorld(*workspace_.cloud, *surface_cloud_);
+    if (!surface_cloud_->empty())
+    {
+        std::string surface_cloud_path = save_folder + "/frame_" + save_num + "_surface_cloud" + ".pcd";
+        pcl::io::savePCDFile(surface_cloud_path, *surface_cloud_);
+    }
+
+    if (!oil_cloud_->empty())
+    {
+        std::string oil_cloud_path = save_folder + "/frame_" + save_num + "_oil_cloud" + ".pcd";
+        pcl::io::savePCDFile(oil_cloud_path, *oil_cloud_);
+    }
+}
@@ -0,0 +1,275 @@
+#include "oil_detect/organized_plane.h"
+
+#include <algorithm>
+
+bool OrganizedPlane::segment(const cv::Point2f &center, float radius, pcl::PointIndices &plane_inliers,
+                             pcl::ModelCoefficients &plane, pcl::PointIndices &rim)
+{
+    plane_inliers.indices.clear();
+    plane.values.clear();
+    rim.indices.clear();
+    quality_ = PlaneRansac::Quality();
+
+    const int w = roi_.width, h = roi_.height, n = roi_.area();
+    if (n == 0 || radius <= 0)
+    {
+        return false;
+    }
+
+    computeNormals();
+    labels_.assign(n, 0);
+
+    /// 种子圈上的每个种子按其法向平面生长, 保留最大的区域
+    const float cx = center.x - roi_.x, cy = center.y - roi_.y;
+    const int seeds = std::max(params_.seeds, 1);
+    int best_seed = -1;
+    Eigen::Vector4f best_plane;
+    best_region_.clear();
+    for (int k = 0; k < seeds; k++)
+    {
+        const float angle = 2 * (float)M_PI * k / seeds;
+        const int c = (int)std::lround(cx + params_.seed_ratio * radius * std::cos(angle));
+        const int r = (int)std::lround(cy + params_.seed_ratio * radius * std::sin(angle));
+        if (c < 0 || r < 0 || c >= w || r >= h)
+        {
+            continue;
+        }
+        const int i = r * w + c;
+        if (labels_[i] != 0 || std::isnan(nz_[i]))
+        {
+            continue; // 已被其他种子的区域覆盖, 或法向无效
+        }
+        const Eigen::Vector4f seed_plane(nx_[i], ny_[i], nz_[i], -(nx_[i] * x_[i] + ny_[i] * y_[i] + nz_[i] * z_[i]));
+        if (grow(i, seed_plane, k + 1) > (int)best_region_.size())
+        {
+            best_region_.swap(region_);
+            best_plane = seed_plane;
+            best_seed = i;
+        }
+    }
+    if ((int)best_region_.size() < params_.min_plane_points)
+    {
+        return false;
+    }
+
+    /// 单个种子的法向有噪声: 用区域的最小二乘平面从同一种子再生长一次
+    region_.swap(best_region_);
+    if (!fitPlane(best_plane))
+    {
+        return false;
+    }
+    best_region_.swap(region_);
+    if (grow(best_seed, best_plane, seeds + 1) < params_.min_plane_points)
+    {
+        region_.swap(best_region_); // 种子本身偏离拟合平面, 保留第一次的区域
+    }
+    if (!fitPlane(best_plane))
+    {
+        return false;
+    }
+
+    plane.values.assign(best_plane.data(), best_plane.data() + 4);
+    plane_inliers.indices.reserve(region_.size());
+    for (const int i : region_)
+    {
+        plane_inliers.indices.push_back(toCloudIndex(i));
+    }
+
+    /// 圆孔边缘: 圆环内与相邻像素深度不连续(或相邻像素无深度)时较近一侧的像素;
+    /// 孔内(平面之后)的像素不计, 法向指向相机, 平面之后的有符号距离为负
+    const float r_in = std::max(1 - params_.rim_band, 0.0f) * radius, r_out = (1 + params_.rim_band) * radius;
+    const int r0 = std::max((int)std::floor(cy - r_out), 0), r1 = std::min((int)std::ceil(cy + r_out), h - 1);
+    const int c0 = std::max((int)std::floor(cx - r_out), 0), c1 = std::min((int)std::ceil(cx + r_out), w - 1);
+    const int offsets[4] = {-1, 1, -w, w};
+    for (int r = r0; r <= r1; r++)
+    {
+        for (int c = c0; c <= c1; c++)
+        {
+            const float du = c - cx, dv = r - cy, d2 = du * du + dv * dv;
+            const int i = r * w + c;
+            if (d2 < r_in * r_in || d2 > r_out * r_out || !valid(i) ||
+                x_[i] * best_plane[0] + y_[i] * best_plane[1] + z_[i] * best_plane[2] + best_plane[3] < -params_.distance_threshold)
+            {
+                continue;
+            }
+            const bool inside[4] = {c > 0, c + 1 < w, r > 0, r + 1 < h};
+            for (int k = 0; k < 4; k++)
+            {
+                const int j = i + offsets[k];
+                if (inside[k] && (!valid(j) || z_[j] - z_[i] > params_.depth_change_factor * z_[i]))
+                {
+                    rim.indices.push_back(toCloudIndex(i));
+                    break;
+                }
+            }
+        }
+    }
+    return (int)rim.indices.size() >= params_.min_rim_points;
+}
+
+void OrganizedPlane::computeNormals()
+{
+    const int w = roi_.width, h = roi_.height, n = roi_.area();
+    const int W = w + 1;
+
+    // 积分图: 通道 0-2 为与右侧像素的坐标差, 3 为其计数; 4-7 为与下方像素的
+    integral_.assign(8 * W * (h + 1), 0.0);
+    for (int r = 0; r < h; r++)
+    {
+        double row[8] = {0};
+        for (int c = 0; c < w; c++)
+        {
+            const int i = r * w + c;
+            if (c + 1 < w && connected(i, i + 1))
+            {
+                row[0] += x_[i + 1] - x_[i];
+                row[1] += y_[i + 1] - y_[i];
+                row[2] += z_[i + 1] - z_[i];
+                row[3] += 1;
+            }
+            if (r + 1 < h && connected(i, i + w))
+            {
+                row[4] += x_[i + w] - x_[i];
+                row[5] += y_[i + w] - y_[i];
+                row[6] += z_[i + w] - z_[i];
+                row[7] += 1;
+            }
+            const double *above = &integral_[8 * (r * W + c + 1)];
+            double *out = &integral_[8 * ((r + 1) * W + c + 1)];
+            for (int k = 0; k < 8; k++)
+            {
+                out[k] = above[k] + row[k];
+            }
+        }
+    }
+
+    // 窗口内平均的水平与垂直梯度叉乘得到法向, 指向相机
+    nx_.resize(n);
+    ny_.resize(n);
+    nz_.resize(n);
+    const int k = std::max(params_.normal_window, 1);
+    const int min_count = 2 * k + 1; // 窗口内至少一整行/列的有效差分
+    for (int r = 0; r < h; r++)
+    {
+        const int ra = std::max(r - k, 0), rb = std::min(r + k, h - 1) + 1;
+        for (int c = 0; c < w; c++)
+        {
+            const int i = r * w + c;
+            nx_[i] = ny_[i] = nz_[i] = NAN;
+            if (!valid(i))
+            {
+                continue;
+            }
+            const int ca = std::max(c - k, 0), cb = std::min(c + k, w - 1) + 1;
+            const double *s00 = &integral_[8 * (ra * W + ca)], *s01 = &integral_[8 * (ra * W + cb)];
+            const double *s10 = &integral_[8 * (rb * W + ca)], *s11 = &integral_[8 * (rb * W + cb)];
+            double s[8];
+            for (int m = 0; m < 8; m++)
+            {
+                s[m] = s11[m] - s10[m] - s01[m] + s00[m];
+            }
+            if (s[3] < min_count || s[7] < min_count)
+            {
+                continue;
+            }
+            const Eigen::Vector3d dh(s[0] / s[3], s[1] / s[3], s[2] / s[3]);
+            const Eigen::Vector3d dv(s[4] / s[7], s[5] / s[7], s[6] / s[7]);
+            Eigen::Vector3d normal = dh.cross(dv);
+            const double norm = normal.norm();
+            if (norm <= 0)
+            {
+                continue;
+            }
+            normal /= norm;
+            if (normal[0] * x_[i] + normal[1] * y_[i] + normal[2] * z_[i] > 0)
+            {
+                normal = -normal;
+            }
+            nx_[i] = (float)normal[0];
+            ny_[i] = (float)normal[1];
+            nz_[i] = (float)normal[2];
+        }
+    }
+}
+
+int OrganizedPlane::grow(int seed, const Eigen::Vector4f &plane, int label)
+{
+    const int w = roi_.width, h = roi_.height;
+    const float min_cos = std::cos(params_.max_angle), thr = params_.distance_threshold;
+    auto accept = [&](int i) {
+        return !std::isnan(nz_[i]) && std::abs(nx_[i] * plane[0] + ny_[i] * plane[1] + nz_[i] * plane[2]) >= min_cos &&
+               std::abs(x_[i] * plane[0] + y_[i] * plane[1] + z_[i] * plane[2] + plane[3]) <= thr;
+    };
+
+    region_.clear();
+    stack_.clear();
+    if (!accept(seed))
+    {
+        return 0;
+    }
+    labels_[seed] = label;
+    stack_.push_back(seed);
+    while (!stack_.empty())
+    {
+        const int i = stack_.back();
+        stack_.pop_back();
+        region_.push_back(i);
+
+        const int r = i / w, c = i % w;
+        const int neighbors[4] = {c > 0 ? i - 1 : -1, c + 1 < w ? i + 1 : -1, r > 0 ? i - w : -1, r + 1 < h ? i + w : -1};
+        for (const int j : neighbors)
+        {
+            if (j >= 0 && labels_[j] != label && connected(i, j) && accept(j))
+            {
+                labels_[j] = label;
+                stack_.push_back(j);
+            }
+        }
+    }
+    return (int)region_.size();
+}
+
+bool OrganizedPlane::fitPlane(Eigen::Vector4f &plane)
+{
+    const double count = region_.size();
+    if (count < 3)
+    {
+        return false;
+    }
+
+    // 以首点为原点累计一阶/二阶矩, 避免大坐标下的抵消误差
+    const Eigen::Vector3d origin(x_[region_[0]], y_[region_[0]], z_[region_[0]]);
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d sum_sq = Eigen::Matrix3d::Zero();
+    for (const int i : region_)
+    {
+        const Eigen::Vector3d p = Eigen::Vector3d(x_[i], y_[i], z_[i]) - origin;
+        sum += p;
+        sum_sq += p * p.transpose();
+    }
+    const Eigen::Vector3d mean = sum / count;
+    const Eigen::Matrix3d cov = sum_sq / count - mean * mean.transpose();
+    const Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(cov);
+
+    // 最小特征值对应的特征向量为法向, 指向相机; 质量估计与 PlaneRansac 相同
+    Eigen::Vector3d normal = solver.eigenvectors().col(0);
+    const Eigen::Vector3d centroid = mean + origin;
+    if (normal.dot(centroid) > 0)
+    {
+        normal = -normal;
+    }
+    plane << normal.cast<float>(), (float)-normal.dot(centroid);
+
+    const double var = std::max(solver.eigenvalues()[0], 0.0);
+    quality_ = PlaneRansac::Quality();
+    quality_.inliers = (int)count;
+    quality_.rms = (float)std::sqrt(var);
+    quality_.offset_variance = var / count;
+    for (int k = 1; k < 3; k++)
+    {
+        const double lambda = std::max(solver.eigenvalues()[k], 1e-12);
+        const Eigen::Vector3d axis = solver.eigenvectors().col(k);
+        quality_.normal_covariance += var / (count * lambda) * axis * axis.transpose();
+    }
+    return true;
+}
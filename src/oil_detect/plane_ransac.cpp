@@ -0,0 +1,167 @@
+#include "oil_detect/plane_ransac.h"
+
+#include <random>
+#include <limits>
+#include <algorithm>
+
+#include <Eigen/Dense>
+
+bool PlaneRansac::segment(pcl::PointIndices &inliers, pcl::ModelCoefficients &coefficients)
+{
+    inliers.indices.clear();
+    coefficients.values.clear();
+    iterations_ = 0;
+    quality_ = Quality();
+
+    const int n = (int)x_.size();
+    if (n < 3)
+    {
+        return false;
+    }
+
+    const int batch = std::max(params_.batch_size, 1);
+    batch_planes_.resize(4 * batch);
+    batch_scores_.resize(batch);
+
+    std::mt19937 rng(params_.seed);
+    float best_plane[4] = {0, 0, 0, 0};
+    int best_score = 0;
+    int needed = params_.max_iterations; // 自适应估计的所需迭代次数
+
+    while (iterations_ < needed)
+    {
+        // 顺序生成本批假设, 保证结果只取决于种子
+        const int count = std::min(batch, needed - iterations_);
+        for (int k = 0; k < count; k++)
+        {
+            int i0 = rng() % n, i1 = rng() % n, i2 = rng() % n;
+            float *plane = &batch_planes_[4 * k];
+            if (i0 == i1 || i0 == i2 || i1 == i2 || !hypothesis(i0, i1, i2, plane))
+            {
+                plane[0] = plane[1] = plane[2] = plane[3] = 0; // 退化样本, 评分为0
+            }
+        }
+
+#pragma omp parallel for schedule(static)
+        for (int k = 0; k < count; k++)
+        {
+            const float *plane = &batch_planes_[4 * k];
+            batch_scores_[k] = (plane[0] == 0 && plane[1] == 0 && plane[2] == 0) ? 0 : countInliers(plane);
+        }
+
+        // 按生成顺序取最优, 得分相同取先生成的
+        for (int k = 0; k < count; k++)
+        {
+            if (batch_scores_[k] > best_score)
+            {
+                best_score = batch_scores_[k];
+                std::copy(&batch_planes_[4 * k], &batch_planes_[4 * k] + 4, best_plane);
+
+                // k = log(1-p) / log(1-w^3)
+                const double w = (double)best_score / n;
+                const double p_fail = 1.0 - w * w * w;
+                if (p_fail <= std::numeric_limits<double>::epsilon())
+                {
+                    needed = std::min(needed, iterations_ + k + 1);
+                }
+                else
+                {
+                    const double k_adapt = std::log(1.0 - params_.probability) / std::log(p_fail);
+                    needed = (int)std::min<double>(needed, std::ceil(k_adapt));
+                }
+            }
+        }
+        iterations_ += count;
+    }
+
+    if (best_score < 3)
+    {
+        return false;
+    }
+
+    // 局内点的一阶/二阶矩与残差平方和, 同时用于系数优化与质量估计
+    inliers.indices.reserve(best_score);
+    const float thr = params_.distance_threshold;
+    Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d sum_sq = Eigen::Matrix3d::Zero();
+    double sum_d2 = 0;
+    for (int i = 0; i < n; i++)
+    {
+        const float d = best_plane[0] * x_[i] + best_plane[1] * y_[i] + best_plane[2] * z_[i] + best_plane[3];
+        if (std::abs(d) <= thr)
+        {
+            inliers.indices.push_back(index_[i]);
+            const Eigen::Vector3d p(x_[i], y_[i], z_[i]);
+            sum += p;
+            sum_sq += p * p.transpose();
+            sum_d2 += d * d;
+        }
+    }
+
+    const double count = inliers.indices.size();
+    const Eigen::Vector3d mean = sum / count;
+    const Eigen::Matrix3d cov = sum_sq / count - mean * mean.transpose();
+    const Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(cov);
+    double var = sum_d2 / count;
+    if (params_.refine)
+    {
+        // 协方差最小特征值对应的特征向量为法向, 保持与原模型同向; 最小特征值即到新平面的均方距离
+        Eigen::Vector3d normal = solver.eigenvectors().col(0);
+        if (normal.dot(Eigen::Vector3d(best_plane[0], best_plane[1], best_plane[2])) < 0)
+        {
+            normal = -normal;
+        }
+        best_plane[0] = normal[0];
+        best_plane[1] = normal[1];
+        best_plane[2] = normal[2];
+        best_plane[3] = -normal.dot(mean);
+        var = std::max(solver.eigenvalues()[0], 0.0);
+    }
+    coefficients.values.assign(best_plane, best_plane + 4);
+
+    // 法向沿平面内两个主方向的扰动方差为 σ²/(N·λ), λ 为局内点在该方向上的方差; 位置方差为 σ²/N
+    quality_.inliers = (int)count;
+    quality_.rms = (float)std::sqrt(var);
+    quality_.offset_variance = var / count;
+    for (int k = 1; k < 3; k++)
+    {
+        const double lambda = std::max(solver.eigenvalues()[k], 1e-12);
+        const Eigen::Vector3d axis = solver.eigenvectors().col(k);
+        quality_.normal_covariance += var / (count * lambda) * axis * axis.transpose();
+    }
+    return true;
+}
+
+bool PlaneRansac::hypothesis(int i0, int i1, int i2, float *plane) const
+{
+    const float ux = x_[i1] - x_[i0], uy = y_[i1] - y_[i0], uz = z_[i1] - z_[i0];
+    const float vx = x_[i2] - x_[i0], vy = y_[i2] - y_[i0], vz = z_[i2] - z_[i0];
+    const float nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+    const float norm = std::sqrt(nx * nx + ny * ny + nz * nz);
+    if (norm < 1e-12f)
+    {
+        return false;
+    }
+
+    plane[0] = nx / norm;
+    plane[1] = ny / norm;
+    plane[2] = nz / norm;
+    plane[3] = -(plane[0] * x_[i0] + plane[1] * y_[i0] + plane[2] * z_[i0]);
+    return true;
+}
+
+int PlaneRansac::countInliers(const float *plane) const
+{
+    const float a = plane[0], b = plane[1], c = plane[2], d = plane[3];
+    const float thr = params_.distance_threshold;
+    const float *x = x_.data(), *y = y_.data(), *z = z_.data();
+    const int n = (int)x_.size();
+
+    int count = 0;
+#pragma omp simd reduction(+ : count)
+    for (int i = 0; i < n; i++)
+    {
+        count += std::abs(a * x[i] + b * y[i] + c * z[i] + d) <= thr ? 1 : 0;
+    }
+    return count;
+}
@@ -0,0 +1,214 @@
+#include "oil_detect/pose_tracker.h"
+
+#include <cstdio>
+
+// 旋转矩阵与旋转向量互转
+static Eigen::Vector3d rotationLog(const Eigen::Matrix3d &R)
+{
+    const Eigen::AngleAxisd aa(R);
+    return aa.angle() * aa.axis();
+}
+
+static Eigen::Matrix3d rotationExp(const Eigen::Vector3d &w)
+{
+    const double angle = w.norm();
+    if (angle < 1e-12)
+    {
+        return Eigen::Matrix3d::Identity();
+    }
+    return Eigen::AngleAxisd(angle, w / angle).toRotationMatrix();
+}
+
+Pinhole Pinhole::fromLookup(const cv::Mat &lookup_x, const cv::Mat &lookup_y)
+{
+    Pinhole camera;
+    if (lookup_x.empty() || lookup_y.empty() || lookup_x.cols < 2 || lookup_y.rows < 2)
+    {
+        return camera;
+    }
+
+    // lookup_x(r, c) ≈ (c - cx) / fx, lookup_y(r, c) ≈ (r - cy) / fy
+    const int r = lookup_x.rows / 2, c = lookup_x.cols / 2;
+    const float dx = lookup_x.at<float>(r, c) - lookup_x.at<float>(r, c - 1);
+    const float dy = lookup_y.at<float>(r, c) - lookup_y.at<float>(r - 1, c);
+    if (dx <= 0 || dy <= 0)
+    {
+        return camera;
+    }
+    camera.fx = 1.0f / dx;
+    camera.fy = 1.0f / dy;
+    camera.cx = c - lookup_x.at<float>(r, c) * camera.fx;
+    camera.cy = r - lookup_y.at<float>(r, c) * camera.fy;
+    return camera;
+}
+
+void PoseTracker::initialize(double t, const Eigen::Vector3d &position, const Eigen::Matrix3d &rotation,
+                             const Eigen::Matrix3d &position_cov, const Eigen::Matrix3d &rotation_cov)
+{
+    x_.head<3>() = position;
+    x_.tail<3>().setZero();
+    P_.setZero();
+    P_.topLeftCorner<3, 3>() = position_cov;
+    P_.bottomRightCorner<3, 3>() = Eigen::Matrix3d::Identity() * params_.init_velocity_sigma * params_.init_velocity_sigma;
+    rot_ = rotation;
+    P_rot_ = rotation_cov;
+    t_ = t;
+    rejects_ = 0;
+    verified_ = 0;
+    has_reference_ = false; // 参考统计需在新位姿下重新采样
+    initialized_ = true;
+}
+
+void PoseTracker::propagate(double dt, Vector6d &x, Matrix6d &P, Eigen::Matrix3d &P_rot) const
+{
+    if (dt <= 0)
+    {
+        return;
+    }
+    const Eigen::Matrix3d I = Eigen::Matrix3d::Identity();
+    Matrix6d F = Matrix6d::Identity();
+    F.topRightCorner<3, 3>() = dt * I;
+    x = F * x;
+
+    // 白噪声加速度的离散化过程噪声
+    const double q = params_.accel_noise;
+    Matrix6d Q;
+    Q << dt * dt * dt / 3 * q * I, dt * dt / 2 * q * I,
+        dt * dt / 2 * q * I, dt * q * I;
+    P = F * P * F.transpose() + Q;
+    P_rot += params_.rot_noise * dt * I;
+}
+
+bool PoseTracker::update(double t, const Eigen::Vector3d &position, const Eigen::Matrix3d &rotation, const double *covariance)
+{
+    const Eigen::Map<const Eigen::Matrix<double, 6, 6, Eigen::RowMajor>> cov(covariance);
+    const Eigen::Matrix3d I = Eigen::Matrix3d::Identity();
+    const double sp = params_.min_position_sigma, sr = params_.min_rotation_sigma;
+    const Eigen::Matrix3d R_pos = cov.topLeftCorner<3, 3>() + sp * sp * I;
+    const Eigen::Matrix3d R_rot = cov.bottomRightCorner<3, 3>() + sr * sr * I;
+
+    if (!initialized_ || t < t_ || t - t_ > params_.max_gap)
+    {
+        initialize(t, position, rotation, R_pos, R_rot);
+        return true;
+    }
+
+    Vector6d x = x_;
+    Matrix6d P = P_;
+    Eigen::Matrix3d P_rot = P_rot_;
+    propagate(t - t_, x, P, P_rot);
+
+    // 新息与门限
+    const Eigen::Vector3d y = position - x.head<3>();
+    const Eigen::Matrix3d S = P.topLeftCorner<3, 3>() + R_pos;
+    const Eigen::Vector3d y_rot = rotationLog(rotation * rot_.transpose());
+    const Eigen::Matrix3d S_rot = P_rot + R_rot;
+    const double d2 = y.dot(S.ldlt().solve(y));
+    const double d2_rot = y_rot.dot(S_rot.ldlt().solve(y_rot));
+    if (d2 > params_.gate || d2_rot > params_.gate)
+    {
+        if (++rejects_ > params_.max_rejects)
+        {
+            printf("[WARN] Pose tracker lost (%d rejects), reinitialized\n", rejects_);
+            initialize(t, position, rotation, R_pos, R_rot);
+            return true;
+        }
+        printf("[WARN] Pose rejected by tracker gate: position %.1f, rotation %.1f\n", d2, d2_rot);
+        return false;
+    }
+
+    // 平移: H = [I 0]
+    const Eigen::Matrix<double, 6, 3> K = P.leftCols<3>() * S.inverse();
+    x_ = x + K * y;
+    P_ = P - K * P.topRows<3>();
+    P_ = 0.5 * (P_ + P_.transpose());
+
+    // 姿态
+    const Eigen::Matrix3d K_rot = P_rot * S_rot.inverse();
+    rot_ = rotationExp(K_rot * y_rot) * rot_;
+    P_rot_ = (I - K_rot) * P_rot;
+    P_rot_ = 0.5 * (P_rot_ + P_rot_.transpose());
+
+    t_ = t;
+    rejects_ = 0;
+    verified_ = 0;
+    return true;
+}
+
+void PoseTracker::coast(double t)
+{
+    if (!initialized_)
+    {
+        return;
+    }
+    propagate(t - t_, x_, P_, P_rot_);
+    t_ = std::max(t, t_);
+    verified_++;
+}
+
+bool PoseTracker::predict(double t, Eigen::Vector3d &position, Eigen::Matrix3d &rotation, double *covariance) const
+{
+    if (!initialized_)
+    {
+        return false;
+    }
+    Vector6d x = x_;
+    Matrix6d P = P_;
+    Eigen::Matrix3d P_rot = P_rot_;
+    propagate(t - t_, x, P, P_rot);
+
+    position = x.head<3>();
+    rotation = rot_;
+    if (covariance)
+    {
+        Eigen::Map<Eigen::Matrix<double, 6, 6, Eigen::RowMajor>> cov(covariance);
+        cov.setZero();
+        cov.topLeftCorner<3, 3>() = P.topLeftCorner<3, 3>();
+        cov.bottomRightCorner<3, 3>() = P_rot;
+    }
+    return true;
+}
+
+void PoseTracker::getPose(Eigen::Vector3d &position, Eigen::Matrix3d &rotation, double *covariance) const
+{
+    position = x_.head<3>();
+    rotation = rot_;
+    if (covariance)
+    {
+        Eigen::Map<Eigen::Matrix<double, 6, 6, Eigen::RowMajor>> cov(covariance);
+        cov.setZero();
+        cov.topLeftCorner<3, 3>() = P_.topLeftCorner<3, 3>();
+        cov.bottomRightCorner<3, 3>() = P_rot_;
+    }
+}
+
+bool PoseTracker::canVerify(double t) const
+{
+    if (!initialized_ || !params_.verify || verified_ >= params_.max_verified || !has_reference_)
+    {
+        return false;
+    }
+    if (t < t_ || t - t_ > params_.max_gap)
+    {
+        return false;
+    }
+
+    // 预测位置的最大标准差
+    Vector6d x = x_;
+    Matrix6d P = P_;
+    Eigen::Matrix3d P_rot = P_rot_;
+    propagate(t - t_, x, P, P_rot);
+    const Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(P.topLeftCorner<3, 3>());
+    return std::sqrt(std::max(solver.eigenvalues()[2], 0.0)) <= params_.max_verify_sigma;
+}
+
+bool PoseTracker::projectRim(const Pinhole &camera, const Eigen::Vector3d &position, cv::Point2f &center, float &radius) const
+{
+    if (!camera.valid() || position[2] <= 0 || radius_ <= 0)
+    {
+        return false;
+    }
+    center = camera.project(position);
+    radius = (float)(camera.fx * radius_ / position[2]);
+    return true;
+}
@@ -0,0 +1,198 @@
+#include "oil_detect/voxel_downsample.h"
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+// splitmix64 的末尾混合, 使相邻体素的键分散到不同槽位
+inline uint64_t mixKey(uint64_t key)
+{
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+}
+
+inline uint64_t nextPow2(uint64_t v)
+{
+    uint64_t p = 1;
+    while (p < v)
+        p <<= 1;
+    return p;
+}
+} // namespace
+
+const uint64_t VoxelDownsample::kInvalidKey;
+
+bool VoxelDownsample::filter(const pcl::PointCloud<pcl::PointXYZ> &input, pcl::PointCloud<pcl::PointXYZ> &output)
+{
+    if (isLatticeAligned(input))
+    {
+        return false;
+    }
+
+    const int n = (int)input.size();
+    const pcl::PointXYZ *points = input.points.data();
+    const float inv = 1.0f / params_.leaf_size;
+    const int64_t bias = 1 << 20, range = 1 << 21; // 每轴21位, 约 ±1e6 个体素
+
+    // 体素键, 无效点与超出范围的点标记为无效
+    keys_.resize(n);
+    slot_.resize(n);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; i++)
+    {
+        const pcl::PointXYZ &p = points[i];
+        if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+        {
+            keys_[i] = kInvalidKey;
+            continue;
+        }
+        const int64_t ix = (int64_t)std::floor(p.x * inv) + bias;
+        const int64_t iy = (int64_t)std::floor(p.y * inv) + bias;
+        const int64_t iz = (int64_t)std::floor(p.z * inv) + bias;
+        if (ix < 0 || iy < 0 || iz < 0 || ix >= range || iy >= range || iz >= range)
+        {
+            keys_[i] = kInvalidKey;
+            continue;
+        }
+        keys_[i] = ((uint64_t)ix << 42) | ((uint64_t)iy << 21) | (uint64_t)iz;
+    }
+
+    // 哈希表按键的高位分区, 每个分区由一个线程独占插入, 无需加锁
+#ifdef _OPENMP
+    const int partitions = (int)nextPow2(omp_get_max_threads());
+#else
+    const int partitions = 1;
+#endif
+    int part_bits = 0;
+    while ((1 << part_bits) < partitions)
+        ++part_bits;
+    const uint64_t capacity = nextPow2(2 * (uint64_t)n / partitions + 16); // 每个分区的槽位数, 装载率不超过一半
+    const uint64_t mask = capacity - 1;
+    const bool centroid = params_.policy == Policy::Centroid;
+
+    table_.resize(capacity * partitions);
+#pragma omp parallel for schedule(static)
+    for (int64_t s = 0; s < (int64_t)table_.size(); s++)
+    {
+        table_[s].key = kInvalidKey;
+    }
+
+#pragma omp parallel for schedule(static, 1)
+    for (int part = 0; part < partitions; part++)
+    {
+        const uint64_t base = part * capacity;
+        for (int i = 0; i < n; i++)
+        {
+            const uint64_t key = keys_[i];
+            if (key == kInvalidKey)
+            {
+                continue;
+            }
+            const uint64_t h = mixKey(key);
+            if (part_bits > 0 && (int)(h >> (64 - part_bits)) != part)
+            {
+                continue;
+            }
+
+            // 线性探测
+            uint64_t s = h & mask;
+            while (table_[base + s].key != kInvalidKey && table_[base + s].key != key)
+            {
+                s = (s + 1) & mask;
+            }
+            Slot &slot = table_[base + s];
+            if (slot.key == kInvalidKey)
+            {
+                slot.key = key;
+                slot.first = i;
+                slot.count = 0;
+                slot.sum[0] = slot.sum[1] = slot.sum[2] = 0;
+            }
+            slot_[i] = (int)(base + s);
+            if (centroid)
+            {
+                slot.sum[0] += points[i].x;
+                slot.sum[1] += points[i].y;
+                slot.sum[2] += points[i].z;
+            }
+            ++slot.count;
+        }
+    }
+
+    // 按输入顺序输出每个体素的第一个点或均值
+    output.points.resize(n);
+    int count = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (keys_[i] == kInvalidKey || table_[slot_[i]].first != i)
+        {
+            continue;
+        }
+        const Slot &slot = table_[slot_[i]];
+        pcl::PointXYZ &out = output.points[count++];
+        if (centroid)
+        {
+            const float inv_count = 1.0f / slot.count;
+            out.x = slot.sum[0] * inv_count;
+            out.y = slot.sum[1] * inv_count;
+            out.z = slot.sum[2] * inv_count;
+        }
+        else
+        {
+            out = points[i];
+        }
+    }
+    output.points.resize(count);
+    output.width = count;
+    output.height = 1;
+    output.is_dense = true;
+    output.header = input.header;
+    return true;
+}
+
+bool VoxelDownsample::isLatticeAligned(const pcl::PointCloud<pcl::PointXYZ> &input) const
+{
+    const int n = (int)input.size();
+    if (n == 0)
+    {
+        return false;
+    }
+
+    // 以第一个有效点为格点原点
+    int origin = 0;
+    while (origin < n && !std::isfinite(input.points[origin].x))
+        ++origin;
+    if (origin == n)
+    {
+        return false;
+    }
+    const double ox = input.points[origin].x, oy = input.points[origin].y, oz = input.points[origin].z;
+    const double inv = 1.0 / params_.leaf_size;
+    const double tol = params_.lattice_tolerance;
+
+    const int samples = std::max(std::min(params_.lattice_samples, n), 1);
+    const int step = std::max(n / samples, 1);
+    for (int i = origin; i < n; i += step)
+    {
+        const pcl::PointXYZ &p = input.points[i];
+        if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+        {
+            return false; // 含无效点时仍需过滤
+        }
+        const double tx = (p.x - ox) * inv, ty = (p.y - oy) * inv, tz = (p.z - oz) * inv;
+        if (std::abs(tx - std::round(tx)) > tol || std::abs(ty - std::round(ty)) > tol || std::abs(tz - std::round(tz)) > tol)
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,352 @@
+// 精检测各步骤的耗时与精度对比, 离线运行, 不依赖 ROS
+// 用法: test_detect_benchmark [cloud.pcd] [runs]
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/filters/extract_indices.h>
+#include <pcl/segmentation/sac_segmentation.h>
+
+#include "oil_detect/plane_ransac.h"
+#include "oil_detect/circle_fit_2d.h"
+#include "oil_detect/voxel_downsample.h"
+#include "oil_detect/detector_workspace.h"
+
+using PCLPointCloud = pcl::PointCloud<pcl::PointXYZ>;
+
+// 统计堆分配次数, 用于检查检测器缓存复用后每帧是否还有分配
+static std::atomic<long> g_allocations(0);
+
+void *operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+struct Timing
+{
+    std::vector<double> ms;
+
+    template <typename F>
+    void run(int runs, F &&f)
+    {
+        ms.clear();
+        for (int i = 0; i < runs; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            f(i);
+            ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+    double mean() const
+    {
+        double sum = 0;
+        for (double v : ms)
+            sum += v;
+        return ms.empty() ? 0 : sum / ms.size();
+    }
+
+    double median() const
+    {
+        std::vector<double> tmp(ms);
+        std::nth_element(tmp.begin(), tmp.begin() + tmp.size() / 2, tmp.end());
+        return tmp.empty() ? 0 : tmp[tmp.size() / 2];
+    }
+};
+
+struct CircleStats
+{
+    int valid = 0;
+    Eigen::Vector3d center_sum = Eigen::Vector3d::Zero();
+    Eigen::Vector3d center_sq = Eigen::Vector3d::Zero();
+    double radius_sum = 0, inliers_sum = 0, rms_sum = 0;
+
+    void add(const pcl::ModelCoefficients &coef, const pcl::PointIndices &inliers, const PCLPointCloud &cloud)
+    {
+        if (coef.values.size() < 7)
+        {
+            return;
+        }
+        const Eigen::Vector3d c(coef.values[0], coef.values[1], coef.values[2]);
+        const Eigen::Vector3d n = Eigen::Vector3d(coef.values[4], coef.values[5], coef.values[6]).normalized();
+        const double r = coef.values[3];
+
+        // 局内点到圆柱面(以法向为轴)的均方根距离
+        double sq = 0;
+        for (int i : inliers.indices)
+        {
+            const Eigen::Vector3d d = cloud.points[i].getVector3fMap().cast<double>() - c;
+            const double radial = (d - d.dot(n) * n).norm() - r;
+            sq += radial * radial;
+        }
+
+        ++valid;
+        center_sum += c;
+        center_sq += c.cwiseProduct(c);
+        radius_sum += r;
+        inliers_sum += inliers.indices.size();
+        rms_sum += inliers.indices.empty() ? 0 : std::sqrt(sq / inliers.indices.size());
+    }
+
+    Eigen::Vector3d center() const { return center_sum / std::max(valid, 1); }
+
+    // 圆心重复性(各轴标准差的模)
+    double spread() const
+    {
+        const Eigen::Vector3d mean = center();
+        return (center_sq / std::max(valid, 1) - mean.cwiseProduct(mean)).cwiseMax(0).cwiseSqrt().norm();
+    }
+
+    void print(const std::string &name, const Timing &timing, int runs) const
+    {
+        const int n = std::max(valid, 1);
+        printf("%-14s mean %8.3f ms, median %8.3f ms, valid %d/%d, radius %.5f, inliers %.0f, rms %.5f m, center spread %.5f m\n",
+               name.c_str(), timing.mean(), timing.median(), valid, runs, radius_sum / n, inliers_sum / n, rms_sum / n, spread());
+    }
+};
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const std::string path = argc > 1 ? argv[1] : "data/oil_cloud.pcd";
+    const int runs = argc > 2 ? std::max(std::atoi(argv[2]), 1) : 50;
+
+    PCLPointCloud::Ptr cloud(new PCLPointCloud);
+    if (pcl::io::loadPCDFile(path, *cloud) != 0 || cloud->empty())
+    {
+        printf("[ERROR] Could not load %s\n", path.c_str());
+        return 1;
+    }
+
+    printf("[INFO] %s: %zu points, %d runs\n", path.c_str(), cloud->size(), runs);
+    Timing timing;
+
+    /// 体素化(0.5mm): VoxelGrid vs VoxelDownsample
+    PCLPointCloud::Ptr voxel(new PCLPointCloud);
+    timing.run(runs, [&](int) {
+        pcl::VoxelGrid<pcl::PointXYZ> sor;
+        sor.setInputCloud(cloud);
+        sor.setLeafSize(0.0005f, 0.0005f, 0.0005f);
+        sor.filter(*voxel);
+    });
+    printf("%-14s mean %8.3f ms, median %8.3f ms, points %zu\n", "voxel_grid", timing.mean(), timing.median(), voxel->size());
+
+    VoxelDownsample downsample;
+    bool filtered = true;
+    timing.run(runs, [&](int) { filtered = downsample.filter(*cloud, *voxel); });
+    if (!filtered)
+    {
+        *voxel = *cloud;
+    }
+    printf("%-14s mean %8.3f ms, median %8.3f ms, points %zu%s\n", "voxel_hash", timing.mean(), timing.median(), voxel->size(),
+           filtered ? "" : " (input on lattice, skipped)");
+
+    /// 平面: SACSegmentation vs PlaneRansac
+    pcl::PointIndices plane_inliers;
+    pcl::ModelCoefficients plane_coef;
+
+    timing.run(runs, [&](int) {
+        pcl::SACSegmentation<pcl::PointXYZ> seg;
+        seg.setInputCloud(voxel);
+        seg.setOptimizeCoefficients(false);
+        seg.setModelType(pcl::SACMODEL_PLANE);
+        seg.setMethodType(pcl::SAC_RANSAC);
+        seg.setDistanceThreshold(0.001);
+        seg.setMaxIterations(10000);
+        seg.segment(plane_inliers, plane_coef);
+    });
+    printf("%-14s mean %8.3f ms, median %8.3f ms, inliers %zu\n", "sac_plane", timing.mean(), timing.median(),
+           plane_inliers.indices.size());
+
+    PlaneRansac plane_ransac;
+    timing.run(runs, [&](int i) {
+        plane_ransac.params().seed = 12345 + i;
+        plane_ransac.setInputCloud(*voxel);
+        plane_ransac.segment(plane_inliers, plane_coef);
+    });
+    printf("%-14s mean %8.3f ms, median %8.3f ms, inliers %zu, iterations %d\n", "plane_ransac", timing.mean(),
+           timing.median(), plane_inliers.indices.size(), plane_ransac.iterations());
+    if (plane_coef.values.size() < 4)
+    {
+        printf("[ERROR] Plane not found\n");
+        return 1;
+    }
+
+    // 平面上方 1~10cm 的点, 与 OilAccurateDetect::classifyPoints 一致
+    const Eigen::Vector4f plane(plane_coef.values[0], plane_coef.values[1], plane_coef.values[2], plane_coef.values[3]);
+    PCLPointCloud::Ptr rim(new PCLPointCloud);
+    for (const auto &p : voxel->points)
+    {
+        const float dis = std::abs(plane.head<3>().dot(p.getVector3fMap()) + plane[3]) / plane.head<3>().norm();
+        if (dis >= 0.01f && dis <= 0.1f)
+        {
+            rim->push_back(p);
+        }
+    }
+    printf("[INFO] %zu points above plane\n", rim->size());
+
+    /// 圆: SACMODEL_CIRCLE3D vs CircleFit2D
+    pcl::PointIndices circle_inliers;
+    pcl::ModelCoefficients circle_coef;
+
+    CircleStats sac_stats;
+    timing.run(runs, [&](int) {
+        pcl::SACSegmentation<pcl::PointXYZ> seg;
+        seg.setInputCloud(rim);
+        seg.setOptimizeCoefficients(false);
+        seg.setModelType(pcl::SACMODEL_CIRCLE3D);
+        seg.setAxis({plane[0], plane[1], plane[2]});
+        seg.setRadiusLimits(0.04, 0.043);
+        seg.setMethodType(pcl::SAC_RANSAC);
+        seg.setDistanceThreshold(0.003);
+        seg.setMaxIterations(1000);
+        seg.segment(circle_inliers, circle_coef);
+        sac_stats.add(circle_coef, circle_inliers, *rim);
+    });
+    sac_stats.print("sac_circle3d", timing, runs);
+
+    CircleFit2D circle_fit;
+    circle_fit.params().distance_threshold = 0.003f;
+    circle_fit.params().min_radius = 0.04f;
+    circle_fit.params().max_radius = 0.043f;
+    circle_fit.params().max_iterations = 1000;
+    CircleStats fit_stats;
+    timing.run(runs, [&](int i) {
+        circle_fit.params().seed = 12345 + i;
+        circle_fit.setInputCloud(*rim, plane);
+        if (circle_fit.fit(circle_inliers, circle_coef))
+        {
+            fit_stats.add(circle_coef, circle_inliers, *rim);
+        }
+    });
+    fit_stats.print("circle_fit_2d", timing, runs);
+
+    printf("[INFO] center difference %.5f m\n", (sac_stats.center() - fit_stats.center()).norm());
+
+    /// ROI 提取: 原三趟(拷贝 ROI -> 有效深度求最小值 -> 最小深度以下 10cm 内的点) vs DetectorWorkspace::extractBand
+    // 以输入点循环填充 640x480 的有组织点云, 每7个像素一个无效点, ROI 为中心 240x240
+    PCLPointCloud organized;
+    organized.width = 640;
+    organized.height = 480;
+    organized.points.resize(organized.width * organized.height);
+    for (size_t i = 0; i < organized.points.size(); i++)
+    {
+        organized.points[i] = cloud->points[i % cloud->size()];
+        if (i % 7 == 0)
+        {
+            organized.points[i].z = NAN;
+        }
+    }
+    const int roi_x = 200, roi_y = 120, roi_w = 240, roi_h = 240;
+
+    PCLPointCloud::Ptr roi_tmp(new PCLPointCloud), roi_band(new PCLPointCloud);
+    std::vector<float> roi_depth;
+    timing.run(runs, [&](int) {
+        roi_tmp->points.clear();
+        for (int row = roi_y; row < roi_y + roi_h; row++)
+        {
+            for (int col = roi_x; col < roi_x + roi_w; col++)
+            {
+                const pcl::PointXYZ &p = organized.points[row * organized.width + col];
+                roi_tmp->points.push_back(pcl::PointXYZ(p.x, p.y, p.z));
+            }
+        }
+        roi_depth.clear();
+        for (const auto &p : roi_tmp->points)
+        {
+            if (!std::isnan(p.z) && p.z > 0)
+            {
+                roi_depth.push_back(p.z);
+            }
+        }
+        const double min_depth = *std::min_element(roi_depth.begin(), roi_depth.end());
+        roi_band->clear();
+        for (const auto &p : roi_tmp->points)
+        {
+            if (p.z > 0 && p.z < min_depth + 0.1)
+            {
+                roi_band->push_back(p);
+            }
+        }
+    });
+    printf("%-14s mean %8.3f ms, median %8.3f ms, valid %zu, band %zu\n", "roi_3pass", timing.mean(), timing.median(),
+           roi_depth.size(), roi_band->size());
+
+    DetectorWorkspace band_workspace;
+    PCLPointCloud fused;
+    DetectorWorkspace::BandStats band_stats;
+    timing.run(runs, [&](int) { band_stats = band_workspace.extractBand(organized, roi_x, roi_y, roi_w, roi_h, 0.1, fused); });
+    bool same = fused.size() == roi_band->size() && band_stats.valid == (int)roi_depth.size();
+    for (size_t i = 0; same && i < fused.size(); i++)
+    {
+        same = fused.points[i].getVector3fMap() == roi_band->points[i].getVector3fMap();
+    }
+    printf("%-14s mean %8.3f ms, median %8.3f ms, valid %d, band %zu, %s\n", "roi_fused", timing.mean(), timing.median(),
+           band_stats.valid, fused.size(), same ? "identical" : "MISMATCH");
+    if (!same)
+    {
+        printf("[ERROR] Fused ROI extraction differs from the three-pass version\n");
+        return 1;
+    }
+
+    /// 每帧堆分配次数: 与 OilFillerPose::ofPlaneCal 相同的流程(拷贝点云 -> 平面 -> 平面外点 -> 圆), 缓存在多帧间复用
+    DetectorWorkspace workspace;
+    workspace.plane_ransac.params().distance_threshold = 0.001f;
+    workspace.plane_ransac.params().refine = true;
+    workspace.circle_fit.params() = circle_fit.params();
+    workspace.reserve(voxel->size());
+    auto frame = [&]() {
+        workspace.cloud->points.clear();
+        for (const auto &p : voxel->points)
+        {
+            workspace.cloud->points.push_back(p);
+        }
+        workspace.plane_ransac.setInputCloud(*workspace.cloud);
+        workspace.plane_ransac.segment(*workspace.inliers, *workspace.plane);
+        workspace.complementInliers((int)workspace.cloud->size());
+        workspace.circle_fit.setInputCloud(*workspace.cloud, plane, workspace.outliers->indices);
+        workspace.circle_fit.fit(*workspace.inliers, *workspace.circle);
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        frame(); // 预热, 缓存增长到稳定容量
+    }
+    const long before = g_allocations.load();
+    for (int i = 0; i < runs; i++)
+    {
+        frame();
+    }
+    const double per_frame = (double)(g_allocations.load() - before) / runs;
+    printf("%-14s %.2f allocations per frame\n", "workspace", per_frame);
+    if (per_frame > 0)
+    {
+        printf("[ERROR] Steady-state frames still allocate\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/image_encodings.h>
+#include <cv_bridge/cv_bridge.h>
+
+#include "camera/receiver_manager.h"
+
+// 多路相机接收吞吐测试: 本进程发布 N 路合成的 640x480 彩色/深度图, 由 ReceiverManager 托管接收,
+// 统计 N = 1..max_streams 时的总点云转换帧率与丢帧数
+struct SyntheticCamera
+{
+    ros::Publisher color_pub, depth_pub, color_info_pub, depth_info_pub;
+    sensor_msgs::ImagePtr color_msg, depth_msg;
+    sensor_msgs::CameraInfo info;
+};
+
+static SyntheticCamera createCamera(ros::NodeHandle &nh, const std::string &ns, int width, int height)
+{
+    SyntheticCamera cam;
+    cam.color_pub = nh.advertise<sensor_msgs::Image>(ns + "/color/image_raw", 5);
+    cam.depth_pub = nh.advertise<sensor_msgs::Image>(ns + "/depth/image_raw", 5);
+    cam.color_info_pub = nh.advertise<sensor_msgs::CameraInfo>(ns + "/color/camera_info", 5);
+    cam.depth_info_pub = nh.advertise<sensor_msgs::CameraInfo>(ns + "/depth/camera_info", 5);
+
+    cv::Mat color(height, width, CV_8UC3);
+    cv::randu(color, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::Mat depth(height, width, CV_16UC1);
+    for (int r = 0; r < height; r++)
+        for (int c = 0; c < width; c++)
+            depth.at<uint16_t>(r, c) = 600 + (r + c) % 200;
+
+    cam.color_msg = cv_bridge::CvImage(std_msgs::Header(), sensor_msgs::image_encodings::BGR8, color).toImageMsg();
+    cam.depth_msg = cv_bridge::CvImage(std_msgs::Header(), sensor_msgs::image_encodings::TYPE_16UC1, depth).toImageMsg();
+
+    cam.info.width = width;
+    cam.info.height = height;
+    cam.info.distortion_model = "plumb_bob";
+    cam.info.D = {0.0, 0.0, 0.0, 0.0, 0.0};
+    cam.info.K = {615.0, 0.0, width / 2.0, 0.0, 615.0, height / 2.0, 0.0, 0.0, 1.0};
+    return cam;
+}
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "test_multi_receiver");
+    ros::NodeHandle node("~");
+
+    int max_streams, fps, seconds, spin_threads, worker_threads;
+    node.param("max_streams", max_streams, 4);
+    node.param("fps", fps, 30);
+    node.param("seconds", seconds, 10);
+    node.param("spin_threads", spin_threads, 1);
+    node.param("worker_threads", worker_threads, 2);
+
+    std::cout << "streams, offered_fps, converted_fps, dropped" << std::endl;
+    for (int n = 1; n <= max_streams && ros::ok(); n++)
+    {
+        ros::NodeHandle nh;
+        std::vector<SyntheticCamera> cameras;
+        for (int i = 0; i < n; i++)
+            cameras.push_back(createCamera(nh, "/bench/cam" + std::to_string(i), 640, 480));
+
+        // 发布线程
+        std::atomic<bool> publishing(true);
+        std::thread publisher([&]() {
+            ros::Rate rate(fps);
+            while (publishing && ros::ok())
+            {
+                ros::Time stamp = ros::Time::now();
+                for (auto &cam : cameras)
+                {
+                    cam.color_msg->header.stamp = cam.depth_msg->header.stamp = cam.info.header.stamp = stamp;
+                    cam.color_pub.publish(cam.color_msg);
+                    cam.depth_pub.publish(cam.depth_msg);
+                    cam.color_info_pub.publish(cam.info);
+                    cam.depth_info_pub.publish(cam.info);
+                }
+                rate.sleep();
+            }
+        });
+
+        ReceiverManager manager(spin_threads, worker_threads);
+        for (int i = 0; i < n; i++)
+        {
+            std::string ns = "/bench/cam" + std::to_string(i);
+            manager.addStream(std::make_shared<CameraReceiver>(nh, ns + "/color/image_raw", ns + "/depth/image_raw", true, false, fps), n - i);
+        }
+        manager.start();
+
+        uint64_t converted_begin = manager.totalConverted();
+        uint64_t dropped_begin = manager.totalDropped();
+        ros::WallTime begin = ros::WallTime::now();
+        ros::WallDuration(seconds).sleep();
+        double elapsed = (ros::WallTime::now() - begin).toSec();
+        uint64_t converted = manager.totalConverted() - converted_begin;
+        uint64_t dropped = manager.totalDropped() - dropped_begin;
+
+        publishing = false;
+        publisher.join();
+        manager.stop();
+
+        std::cout << n << ", " << n * fps << ", " << converted / elapsed << ", " << dropped << std::endl;
+    }
+
+    return 0;
+}